@@ -0,0 +1,363 @@
+/**
+ * @file loopback.c
+ *
+ * @brief End-to-end loopback of the signal path: text is encoded into
+ *        a keying timeline, rendered as a sampled keying signal, put
+ *        through a channel with timing jitter, and received again, a
+ *        character at a time, as the signal arrives
+ *
+ * Usage: @c loopback [jitter_ms [min_accuracy]]
+ *
+ * For every speed in @e s_wpm it reports the throughput of the whole
+ * path, the latency of a character, from the key-up after its last
+ * element to its emission by the receiver, and the accuracy of the
+ * round trip.  The latency is given in two parts: the wait for the
+ * key-up to be long enough to be a gap between characters, which is
+ * fixed by the speed, and the time the receiver takes from the first
+ * sample of that key-up to the emission, measured on the monotonic
+ * clock (the signal is not paced in real time, so the wait is not part
+ * of it).  The exit status is not zero if the accuracy at any speed
+ * is below @e min_accuracy (a percentage, 100 by default), so it can be
+ * used as a regression gate of the signal path.
+ */
+
+/* Needed by 'clock_gettime' in C99 */
+#define _POSIX_C_SOURCE 199309L
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* System includes */
+#include <ctype.h>  /* toupper */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>   /* clock, clock_gettime, CLOCK_MONOTONIC */
+
+/* Project includes */
+#include <morse.h>
+
+
+/* Sampling rate of the keying signal, in Hz */
+#define LOOPBACK_SAMPLE_RATE (8000)
+
+/* Times every message of the corpus is sent at each speed */
+#define LOOPBACK_ROUNDS (20)
+
+/* Longest message, in characters */
+#define LOOPBACK_TEXT_MAX (128)
+
+/* Longest timeline of a message */
+#define LOOPBACK_TIMELINE_MAX (4 * LOOPBACK_TEXT_MAX * \
+        MORSE_ALPHABET_MAX_ELEMENTS)
+
+
+/* Messages sent through the loopback */
+static const char *s_corpus[] = {
+    "CQ CQ CQ DE EA4XYZ EA4XYZ K",
+    "EA4XYZ DE DL9QQ UR RST 599 5NN TU",
+    "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789",
+    "WHAT HATH GOD WROUGHT",
+    "QTH MADRID = NAME JOSE = HW CPY +",
+    "1/2 SOS SOS SOS DE 3A2B/M",
+};
+
+/* Speeds, in words per minute */
+static const unsigned s_wpm[] = {5, 13, 20, 30, 40, 60};
+
+
+/* Uniform pseudo-random integer in [-range, range] */
+static long s_jitter(unsigned long *state, long range)
+{
+    if (range <= 0) {
+        return 0;
+    }
+
+    *state = *state * 6364136223846793005ul + 1442695040888963407ul;
+
+    return (long) ((*state >> 33) % (unsigned long) (2 * range + 1)) - range;
+}
+
+
+/* Render a timeline as a keying signal, moving each edge randomly */
+static size_t s_render(uint8_t *signal, size_t signal_size,
+        const uint8_t *timeline, size_t timeline_len, size_t unit,
+        long jitter, unsigned long *state)
+{
+    size_t nominal = 0;
+    size_t start = 0;
+
+    for (size_t i = 0; i < timeline_len; ++i) {
+        long edge;
+        size_t end;
+
+        nominal += timeline[i] * unit;
+        edge = (long) nominal + s_jitter(state, jitter);
+        end = (edge > (long) start) ? (size_t) edge : start;
+        if (end > signal_size) {
+            end = signal_size;
+        }
+
+        memset(&signal[start], (i % 2 == 0) ? 1 : 0, end - start);
+        start = end;
+    }
+
+    return start;
+}
+
+
+/* Nanoseconds on the monotonic clock */
+static uint64_t s_now(void)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+
+/* Length of a run of the keying signal, in units */
+static uint8_t s_units(size_t run, size_t unit)
+{
+    size_t units = (run + unit / 2) / unit;
+
+    return (uint8_t) ((units > UINT8_MAX) ? UINT8_MAX : units);
+}
+
+
+/* Decode a character from the runs measured since the previous one, and
+ * append it to the text received */
+static int s_emit(morse_tree_td *morse, char *text, size_t text_size,
+        size_t *text_len, const uint8_t *runs, size_t n_runs, bool space)
+{
+    char decoded[8];
+    size_t decoded_len;
+
+    if (morse_decode_timeline(morse, decoded, sizeof(decoded),
+                &decoded_len, runs, n_runs) != 0 ||
+            *text_len + 1 + decoded_len >= text_size) {
+        return -1;
+    }
+
+    if (space && *text_len > 0 && decoded_len > 0) {
+        text[(*text_len)++] = ' ';
+    }
+    memcpy(&text[*text_len], decoded, decoded_len + 1);
+    *text_len += decoded_len;
+
+    return 0;
+}
+
+
+/* Receive a keying signal as it arrives, sample by sample: the runs are
+ * measured as they end, and each character is decoded and emitted as
+ * soon as the key-up after it is long enough to be a gap between
+ * characters, adding the nanoseconds from the first sample of that
+ * key-up to the emission to 'latency'; a character still pending at
+ * the end of the signal is emitted then, without a latency */
+static int s_receive(morse_tree_td *morse, char *text, size_t text_size,
+        const uint8_t *signal, size_t signal_len, size_t unit,
+        uint64_t *latency, size_t *emitted)
+{
+    uint8_t runs[2 * MORSE_ALPHABET_MAX_ELEMENTS];
+    size_t char_gap = MORSE_UNITS_CHAR_GAP_MIN * unit - unit / 2;
+    size_t word_gap = MORSE_UNITS_WORD_GAP_MIN * unit - unit / 2;
+    size_t text_len = 0;
+    size_t n_runs = 0;
+    size_t start = 0;
+    uint64_t key_up = 0;
+    bool space = false;
+
+    text[0] = '\0';
+
+    for (size_t i = 0; i < signal_len; ++i) {
+        size_t run = i + 1 - start;
+
+        if (signal[i] == 0 && run == 1 && n_runs > 0) {
+            key_up = s_now();
+        }
+
+        /* A key-up long enough ends the character pending, if any */
+        if (signal[i] == 0 && run == char_gap && n_runs > 0) {
+            if (s_emit(morse, text, text_size, &text_len, runs, n_runs,
+                        space) != 0) {
+                return -1;
+            }
+            *latency += s_now() - key_up;
+            ++(*emitted);
+            n_runs = 0;
+            space = false;
+        }
+
+        if (i + 1 < signal_len && signal[i + 1] == signal[i]) {
+            continue;
+        }
+
+        /* The run ends here: key-downs and the gaps between them are
+         * part of the character, longer key-ups separate characters */
+        if (signal[i] == 1 || (run < char_gap && n_runs > 0)) {
+            if (n_runs < sizeof(runs)) {
+                runs[n_runs++] = s_units(run, unit);
+            }
+        } else if (run >= word_gap) {
+            space = true;
+        }
+        start = i + 1;
+    }
+
+    /* The gaps between elements come in pairs with the key-downs */
+    if (n_runs > 0) {
+        return s_emit(morse, text, text_size, &text_len, runs,
+                n_runs - (n_runs % 2 == 0), space);
+    }
+
+    return 0;
+}
+
+
+/* Number of characters to edit to turn one string into another */
+static size_t s_distance(const char *s1, const char *s2)
+{
+    size_t row[LOOPBACK_TEXT_MAX + 1];
+    size_t len2 = strlen(s2);
+
+    if (len2 > LOOPBACK_TEXT_MAX) {
+        len2 = LOOPBACK_TEXT_MAX;
+    }
+
+    for (size_t j = 0; j <= len2; ++j) {
+        row[j] = j;
+    }
+
+    for (size_t i = 1; s1[i - 1] != '\0'; ++i) {
+        size_t diagonal = row[0];
+
+        row[0] = i;
+        for (size_t j = 1; j <= len2; ++j) {
+            size_t above = row[j];
+            size_t best = diagonal + (s1[i - 1] != s2[j - 1]);
+
+            if (row[j - 1] + 1 < best) {
+                best = row[j - 1] + 1;
+            }
+            if (above + 1 < best) {
+                best = above + 1;
+            }
+            row[j] = best;
+            diagonal = above;
+        }
+    }
+
+    return row[len2];
+}
+
+
+/* Main entry */
+int main(int argc, char *argv[])
+{
+    morse_tree_td *morse;
+    double jitter_ms = (argc > 1) ? strtod(argv[1], NULL) : 0.0;
+    double min_accuracy = (argc > 2) ? strtod(argv[2], NULL) : 100.0;
+    size_t n_corpus = sizeof(s_corpus) / sizeof(s_corpus[0]);
+    size_t n_wpm = sizeof(s_wpm) / sizeof(s_wpm[0]);
+    unsigned long state = 1;
+    int status = 0;
+
+    morse = morse_init();
+    if (morse == NULL) {
+        return 1;
+    }
+
+    printf("Loopback: %d Hz keying signal, edge jitter +/-%.1f ms\n\n",
+            LOOPBACK_SAMPLE_RATE, jitter_ms);
+    printf("  WPM   chars/s   gap wait (ms)   receiver (us)   "
+            "accuracy (%%)\n");
+
+    for (size_t w = 0; w < n_wpm; ++w) {
+        /* The unit (a 'dit') lasts 1.2 s / WPM */
+        size_t unit = LOOPBACK_SAMPLE_RATE * 6 / (5 * s_wpm[w]);
+        long jitter = (long) (jitter_ms * LOOPBACK_SAMPLE_RATE / 1000.0);
+        size_t chars = 0;
+        size_t errors = 0;
+        uint64_t latency = 0;
+        size_t emitted = 0;
+        clock_t start = clock();
+        double seconds;
+        double accuracy;
+
+        for (size_t r = 0; r < LOOPBACK_ROUNDS; ++r) {
+            for (size_t m = 0; m < n_corpus; ++m) {
+                uint8_t timeline[LOOPBACK_TIMELINE_MAX];
+                char expected[LOOPBACK_TEXT_MAX + 1];
+                char decoded[LOOPBACK_TEXT_MAX + 1];
+                morse_output_td out;
+                uint8_t *signal;
+                size_t signal_len;
+                int received;
+
+                memset(&out, 0, sizeof(out));
+                out.requested = MORSE_OUTPUT_TIMELINE | MORSE_OUTPUT_DURATION;
+                out.timeline = timeline;
+                out.timeline_size = sizeof(timeline);
+
+                if (morse_encode_multi(morse, &out, s_corpus[m],
+                            strlen(s_corpus[m]), MORSE_NO_FLAGS) != 0) {
+                    fprintf(stderr, "Encoding failed\n");
+                    morse_destroy(morse);
+                    return 2;
+                }
+
+                signal = malloc((size_t) out.duration * unit + 1);
+                if (signal == NULL) {
+                    morse_destroy(morse);
+                    return 2;
+                }
+
+                signal_len = s_render(signal, (size_t) out.duration * unit,
+                        timeline, out.timeline_len, unit, jitter, &state);
+                received = s_receive(morse, decoded, sizeof(decoded),
+                        signal, signal_len, unit, &latency, &emitted);
+                free(signal);
+
+                if (received != 0) {
+                    fprintf(stderr, "Decoding failed\n");
+                    morse_destroy(morse);
+                    return 2;
+                }
+
+                /* What a perfect round trip gives back */
+                for (size_t i = 0; i <= strlen(s_corpus[m]); ++i) {
+                    expected[i] = (char) toupper(
+                            (unsigned char) s_corpus[m][i]);
+                }
+
+                chars += strlen(expected);
+                errors += s_distance(expected, decoded);
+            }
+        }
+
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        accuracy = 100.0 * (1.0 - (double) errors / (double) chars);
+
+        /* The wait is fixed by the threshold of the gap between
+         * characters; the time of the receiver is measured */
+        printf("  %3u   %7.0f   %13.1f   %13.2f   %12.2f\n", s_wpm[w],
+                (seconds > 0.0) ? (double) chars / seconds : 0.0,
+                1000.0 * (double) (MORSE_UNITS_CHAR_GAP_MIN * unit -
+                    unit / 2) / LOOPBACK_SAMPLE_RATE,
+                (emitted > 0) ? (double) latency / (1000.0 *
+                    (double) emitted) : 0.0, accuracy);
+
+        if (accuracy < min_accuracy) {
+            status = 1;
+        }
+    }
+
+    morse_destroy(morse);
+
+    return status;
+}
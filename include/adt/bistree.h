@@ -13,6 +13,7 @@
 
 /* Data type includes */
 #include <stdbool.h>
+#include <stddef.h>
 
 /* ADT includes */
 #include <adt/bitree.h> /* Binary tree */
@@ -122,6 +123,32 @@ int bistree_remove(bistree_td *tree, const void *data);
  */
 int bistree_lookup(bistree_td *tree, void **data);
 
+/**
+ * @brief Determine whether several nodes match the specified data
+ *
+ * The searches are advanced in small groups, one step at a time each,
+ * and every step prefetches the memory needed by the next one, so the
+ * cache misses of a search overlap with the work done by the others.
+ * This pays off when the tree is far larger than the cache.
+ *
+ * @param tree   Tree to look up in
+ * @param data   Array of @p count pointers to the data to look for
+ * @param status Array of @p count elements receiving the status of each
+ *               lookup, as returned by @e bistree_lookup
+ * @param count  Number of elements to look for
+ *
+ * @return Number of elements found in the binary search tree
+ *
+ * @note Each element of @e data that is found points to the matching
+ *       data in the binary search tree upon return
+ * @note Complexity: @e O(m log n), where @e m is @p count and @e n is
+ *       the number of nodes in the binary search tree
+ *
+ * @see bistree_lookup
+ */
+size_t bistree_lookup_many(bistree_td *tree, void **data, int *status,
+        size_t count);
+
 /**
  * @brief Macro that evaluates to the data of a node
  *
@@ -74,11 +74,16 @@
 
 /* Data type includes */
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* ADT includes */
 #include <adt/bistree.h>
 
+/* Local includes */
+#include <morse_alphabet.h>
+#include <morse_cache.h>
+
 
 /* Macros */
 #define MORSE_MAX_NODES (45)
@@ -88,6 +93,17 @@
 #define MORSE_USE_SEPARATORS (1 << 0)
 #define MORSE_USE_PROSIGNS   (1 << 1)
 
+/* Outputs of a fused encoding pass */
+#define MORSE_OUTPUT_TEXT     (1 << 0)  /* Morse text, as 'morse_encode' */
+#define MORSE_OUTPUT_TIMELINE (1 << 1)  /* Key-down/key-up durations */
+#define MORSE_OUTPUT_DURATION (1 << 2)  /* Airtime in units */
+#define MORSE_OUTPUT_BITS     (1 << 3)  /* Key state, one bit per unit */
+
+/* Decision thresholds of a keying timeline, in units */
+#define MORSE_UNITS_DAH_MIN      (2)    /* Shortest key-down read as dah */
+#define MORSE_UNITS_CHAR_GAP_MIN (2)    /* Shortest gap between chars */
+#define MORSE_UNITS_WORD_GAP_MIN (5)    /* Shortest gap between words */
+
 /* Message representation */
 #define MORSE_MESSAGE_MAX_LENGTH (500)  /* Max. characters of transmission */
 #define MORSE_DIT "."                   /* A dot, or "dit" (.) */
@@ -119,6 +135,34 @@
 typedef bistree_td morse_tree_td;
 
 
+/**
+ * @brief Outputs requested from a fused encoding pass, and their buffers
+ *
+ * Only the buffers of the requested outputs need to be set.  Durations
+ * are given in units (see @e MORSE_UNITS_DIT and friends), and run from
+ * the first key-down to the last key-up, so no trailing gap is counted.
+ */
+typedef struct {
+    uint8_t requested;      /**< Mask of @e MORSE_OUTPUT_* values */
+
+    char *text;             /**< Morse text */
+    size_t text_size;       /**< Capacity of @e text, terminator included */
+    size_t text_len;        /**< Characters written to @e text */
+
+    uint8_t *timeline;      /**< Alternating key-down and key-up
+                              durations, starting with a key-down */
+    size_t timeline_size;   /**< Capacity of @e timeline */
+    size_t timeline_len;    /**< Durations written to @e timeline */
+
+    uint8_t *bits;          /**< Key state of each unit, 1 being
+                              key-down, most significant bit first */
+    size_t bits_size;       /**< Capacity of @e bits, in bytes */
+    size_t bits_len;        /**< Units written to @e bits */
+
+    uint64_t duration;      /**< Airtime */
+} morse_output_td;
+
+
 /* Public interface */
 /**
  * @brief Initialize the Morse tree
@@ -147,6 +191,29 @@ morse_tree_td *morse_init(void);
 int morse_encode(const morse_tree_td *morse,
         char *dst, const char *src, uint8_t flags);
 
+/**
+ * @brief Encode a buffer into every requested output in a single pass
+ *
+ * Each character is looked up once, and its code word is written to
+ * all the outputs in @p out at the same time, so the Morse text, the
+ * keying timeline and the airtime of a message are obtained without
+ * encoding it again or parsing the Morse text.
+ *
+ * @param morse   Morse tree
+ * @param out     Requested outputs and their buffers; the lengths and
+ *                the duration are set upon return
+ * @param src     Characters to be encoded into Morse
+ * @param src_len Number of characters in @p src
+ * @param flags   Parsing flags, as in @e morse_encode; separators only
+ *                affect the text, since spaces are always sent as
+ *                word gaps
+ *
+ * @return 0 on success, or -1 on invalid parameters, on encoding
+ *         errors or if any requested buffer is too small
+ */
+int morse_encode_multi(const morse_tree_td *morse, morse_output_td *out,
+        const char *src, size_t src_len, uint8_t flags);
+
 /**
  * @brief Decode a full Morse transmission string into plain text
  *
@@ -161,6 +228,8 @@ int morse_encode(const morse_tree_td *morse,
  * @return 0 on success, or -1 on invalid parameters
  *
  * @note Output buffer must be at least @e MORSE_MESSAGE_MAX_LENGTH + 1
+ * @note Longer messages are cut silently at
+ *       @e MORSE_MESSAGE_MAX_LENGTH characters
  * @note Decoded string is trimmed of leading and trailing whitespaces
  * @note If @e MORSE_USE_SEPARATORS is set, this function treats the
  *       multi-space strings @e MORSE_CHAR_SEPARATOR and
@@ -171,6 +240,241 @@ int morse_encode(const morse_tree_td *morse,
 int morse_decode(const morse_tree_td *morse,
         char *dst, const char *src, uint8_t flags);
 
+/**
+ * @brief Encode a buffer of known length into a bounded output buffer
+ *
+ * @param morse    Morse tree
+ * @param dst      Output buffer for the string in Morse code
+ * @param dst_size Capacity of @p dst, terminating null character included
+ * @param dst_len  If not @c NULL, number of characters written to
+ *                 @p dst upon return, not counting the terminator
+ * @param src      Characters to be encoded into Morse
+ * @param src_len  Number of characters in @p src
+ * @param flags    Parsing flags, as in @e morse_encode
+ *
+ * @return 0 on success, or -1 on invalid parameters, on encoding
+ *         errors or if @p dst is too small to hold the result
+ *
+ * @note @p src does not need to be null-terminated, so it may point
+ *       straight into a caller's buffer without any copy
+ * @note The function keeps no state besides its arguments and never
+ *       writes to @p morse, so it may be called concurrently from
+ *       several threads sharing the same Morse tree
+ */
+int morse_encode_buf(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Decode a buffer of known length into a bounded output buffer
+ *
+ * @param morse    Morse tree
+ * @param dst      Output buffer for decoded text
+ * @param dst_size Capacity of @p dst, terminating null character included
+ * @param dst_len  If not @c NULL, number of characters written to
+ *                 @p dst upon return, not counting the terminator
+ * @param src      Morse characters to be decoded
+ * @param src_len  Number of characters in @p src
+ * @param flags    Parsing flags, as in @e morse_decode
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ *
+ * @note When @p dst is too small, it still holds the characters that
+ *       fit, null-terminated
+ * @note Same reentrancy guarantees as @e morse_encode_buf
+ */
+int morse_decode_buf(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Decode a keying timeline into plain text
+ *
+ * This is the inverse of the @e MORSE_OUTPUT_TIMELINE output of
+ * @e morse_encode_multi.  Durations are classified halfway between
+ * their nominal values, so a timeline measured from a real signal and
+ * rounded to units is still decoded when off by one unit: key-downs of
+ * @e MORSE_UNITS_DAH_MIN or more are 'dahs', and key-ups of
+ * @e MORSE_UNITS_CHAR_GAP_MIN and @e MORSE_UNITS_WORD_GAP_MIN or more
+ * end a character and a word, respectively.
+ *
+ * @param morse        Morse tree
+ * @param dst          Output buffer for decoded text
+ * @param dst_size     Capacity of @p dst, terminator included
+ * @param dst_len      If not @c NULL, number of characters written to
+ *                     @p dst upon return, not counting the terminator
+ * @param timeline     Alternating key-down and key-up durations, in
+ *                     units, starting with a key-down
+ * @param timeline_len Number of durations in @p timeline
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ */
+int morse_decode_timeline(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const uint8_t *timeline, size_t timeline_len);
+
+/**
+ * @brief Decode a buffer of known length, decoding repeated words at once
+ *
+ * Same as @e morse_decode_buf, but every word (the Morse characters
+ * between two word separators) is first looked up in @p cache as it was
+ * received.  On a hit, the decoded word is copied at once, without
+ * looking at its elements; on a miss, it's decoded character by
+ * character and inserted in the cache.  Traffic made of a few repeated
+ * words ("CQ", "TEST", "5NN", call signs...) is then decoded mostly
+ * from the cache.
+ *
+ * @param morse    Morse tree
+ * @param cache    Cache of words decoded with @p morse
+ * @param dst      Output buffer for decoded text
+ * @param dst_size Capacity of @p dst, terminating null character included
+ * @param dst_len  If not @c NULL, number of characters written to
+ *                 @p dst upon return, not counting the terminator
+ * @param src      Morse characters to be decoded
+ * @param src_len  Number of characters in @p src
+ * @param flags    Parsing flags, as in @e morse_decode
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ *
+ * @note Words longer than @e MORSE_CACHE_WORD_MAX characters, or sent
+ *       with more than @e MORSE_CACHE_KEY_MAX Morse characters, are
+ *       decoded without the cache
+ * @note When @p dst could fill up, the message is decoded again without
+ *       the cache, so a truncated output is that of @e morse_decode_buf
+ * @note The hit rate is given by @e morse_cache_hits and
+ *       @e morse_cache_misses
+ *
+ * @see morse_decode_buf
+ */
+int morse_decode_cached(const morse_tree_td *morse, morse_cache_td *cache,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Encode several buffers back to back into one output buffer
+ *
+ * @param morse    Morse tree
+ * @param dst      Output buffer receiving every encoded message, each
+ *                 one null-terminated
+ * @param dst_size Capacity of @p dst
+ * @param offsets  Array of @p count elements receiving the offset in
+ *                 @p dst where each encoded message starts
+ * @param src      Array of @p count messages to encode
+ * @param src_len  Array of @p count message lengths
+ * @param count    Number of messages
+ * @param flags    Parsing flags, as in @e morse_encode
+ *
+ * @return 0 on success, or -1 on invalid parameters, on encoding
+ *         errors or if @p dst is too small to hold every message
+ */
+int morse_encode_batch(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *offsets,
+        const char *const *src, const size_t *src_len, size_t count,
+        uint8_t flags);
+
+/**
+ * @brief Decode several buffers back to back into one output buffer
+ *
+ * @param morse    Morse tree
+ * @param dst      Output buffer receiving every decoded message, each
+ *                 one null-terminated
+ * @param dst_size Capacity of @p dst
+ * @param offsets  Array of @p count elements receiving the offset in
+ *                 @p dst where each decoded message starts
+ * @param src      Array of @p count Morse messages to decode
+ * @param src_len  Array of @p count message lengths
+ * @param count    Number of messages
+ * @param flags    Parsing flags, as in @e morse_decode
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold every message
+ */
+int morse_decode_batch(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *offsets,
+        const char *const *src, const size_t *src_len, size_t count,
+        uint8_t flags);
+
+/**
+ * @brief Build the table-driven alphabet of a Morse tree
+ *
+ * @param alphabet Alphabet where the code of every visible character of
+ *                 the tree (filler nodes excluded) is stored
+ * @param morse    Morse tree
+ *
+ * @return 0 on success, or -1 on invalid parameters
+ */
+int morse_alphabet_from_tree(morse_alphabet_td *alphabet,
+        const morse_tree_td *morse);
+
+/**
+ * @brief Encode a buffer of known length using the tables of an alphabet
+ *
+ * Same as @e morse_encode_buf, but every character costs a single table
+ * lookup and the code words come from @p alphabet, e.g., one built by
+ * @e morse_alphabet_optimal or read by @e morse_alphabet_load.
+ *
+ * @return 0 on success, or -1 on invalid parameters, on encoding
+ *         errors (such as prosigns with letters missing from the
+ *         alphabet) or if @p dst is too small to hold the result
+ *
+ * @see morse_encode_buf
+ */
+int morse_alphabet_encode(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Encode into every requested output using an alphabet's tables
+ *
+ * @return 0 on success, or -1 on invalid parameters, on encoding
+ *         errors or if any requested buffer is too small
+ *
+ * @see morse_encode_multi
+ */
+int morse_alphabet_encode_multi(const morse_alphabet_td *alphabet,
+        morse_output_td *out, const char *src, size_t src_len,
+        uint8_t flags);
+
+/**
+ * @brief Decode a buffer of known length using the tables of an alphabet
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ *
+ * @see morse_decode_buf
+ */
+int morse_alphabet_decode(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Decode a buffer of known length using the tables of an alphabet,
+ *        decoding repeated words at once
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ *
+ * @see morse_decode_cached
+ */
+int morse_alphabet_decode_cached(const morse_alphabet_td *alphabet,
+        morse_cache_td *cache, char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags);
+
+/**
+ * @brief Decode a keying timeline using the tables of an alphabet
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small to hold the whole message
+ *
+ * @see morse_decode_timeline
+ */
+int morse_alphabet_decode_timeline(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const uint8_t *timeline, size_t timeline_len);
+
 /**
  * @brief Destroy the Morse binary tree
  *
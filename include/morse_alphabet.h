@@ -0,0 +1,172 @@
+/**
+ * @file morse_alphabet.h
+ *
+ * @brief Table-driven Morse alphabets and custom code assignment
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+/* Code words as heap indices
+ *
+ * Every code word is identified by its position in the Morse tree,
+ * numbered as in a binary heap: the root is 1, the 'dit' child of node
+ * @e i is @e 2i and its 'dah' child is @e 2i+1.  Thus, the index keeps
+ * the elements of the code word as bits below a leading 1, e.g.,
+ * 'A' (.-) is 0b101 = 5 and 'T' (-) is 0b11 = 3.  With up to
+ * @e MORSE_ALPHABET_MAX_ELEMENTS elements every index fits in a byte,
+ * and both directions of the alphabet are plain array lookups.
+ *
+ * Timing (in units):
+ *
+ *    dit: 1   gap between elements: 1   gap between words: 7
+ *    dah: 3   gap between characters: 3
+ */
+
+#ifndef MORSE_ALPHABET_H
+#define MORSE_ALPHABET_H
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <stdio.h>  /* FILE */
+
+
+/* Macros */
+#define MORSE_ALPHABET_SYMBOLS (128)      /* ASCII characters */
+#define MORSE_ALPHABET_MAX_ELEMENTS (7)   /* Elements in a code word */
+#define MORSE_ALPHABET_CODES (1 << (MORSE_ALPHABET_MAX_ELEMENTS + 1))
+#define MORSE_ALPHABET_NO_CODE (0)        /* Symbol without code word */
+
+/* Durations, in units */
+#define MORSE_UNITS_DIT (1)
+#define MORSE_UNITS_DAH (3)
+#define MORSE_UNITS_ELEMENT_GAP (1)
+#define MORSE_UNITS_CHAR_GAP (3)
+#define MORSE_UNITS_WORD_GAP (7)
+
+
+/**
+ * @brief Table-driven Morse alphabet
+ */
+typedef struct {
+    /** Heap index of the code word of each (uppercase) ASCII character,
+     * or @e MORSE_ALPHABET_NO_CODE */
+    uint8_t code[MORSE_ALPHABET_SYMBOLS];
+
+    /** Character assigned to each heap index, or @c '\0' */
+    char symbol[MORSE_ALPHABET_CODES];
+} morse_alphabet_td;
+
+
+/* Public interface */
+/**
+ * @brief Empty an alphabet, so no symbol has a code word
+ *
+ * @param alphabet Alphabet to clear
+ */
+void morse_alphabet_clear(morse_alphabet_td *alphabet);
+
+/**
+ * @brief Assign a code word to a symbol
+ *
+ * @param alphabet Alphabet to modify
+ * @param symbol   Printable ASCII character other than '#', which
+ *                 starts comments in @e morse_alphabet_load (lowercase
+ *                 letters are stored as uppercase)
+ * @param code     Heap index of the code word
+ *
+ * @return 0 on success, or -1 if the symbol is not valid, the index
+ *         is out of range, or either is already assigned
+ */
+int morse_alphabet_assign(morse_alphabet_td *alphabet, char symbol,
+        unsigned code);
+
+/**
+ * @brief Number of elements ('dits' and 'dahs') of a code word
+ *
+ * @param code Heap index of the code word
+ *
+ * @return Number of elements, or 0 for @e MORSE_ALPHABET_NO_CODE
+ */
+unsigned morse_alphabet_length(unsigned code);
+
+/**
+ * @brief Airtime of a code word, including the gap that follows it
+ *
+ * @param code Heap index of the code word
+ *
+ * @return Duration in units of its elements, the gaps between them
+ *         and the gap between characters, or 0 for
+ *         @e MORSE_ALPHABET_NO_CODE
+ */
+unsigned morse_alphabet_cost(unsigned code);
+
+/**
+ * @brief Build the code of minimum expected airtime for a distribution
+ *
+ * @param alphabet Alphabet where the new code is stored
+ * @param counts   Occurrences of each ASCII character in the traffic;
+ *                 only printable characters other than space and '#'
+ *                 with a non-zero count receive a code word
+ *
+ * @return 0 on success, or -1 on invalid parameters or if there are
+ *         more symbols than code words
+ *
+ * @note Characters are delimited by the gap between characters, so
+ *       (as in the International code, where 'E' is a prefix of 'I')
+ *       code words only need to be distinct, not prefix-free.  The
+ *       optimum is then to give the cheapest code words, taking into
+ *       account that a 'dah' costs three times a 'dit', to the most
+ *       frequent symbols.  Ties are broken by character order, so the
+ *       result is deterministic.
+ * @note Lowercase letters are counted together with their uppercase
+ *       counterpart
+ */
+int morse_alphabet_optimal(morse_alphabet_td *alphabet,
+        const unsigned long counts[MORSE_ALPHABET_SYMBOLS]);
+
+/**
+ * @brief Total airtime of some traffic using an alphabet
+ *
+ * @param alphabet Alphabet to measure
+ * @param counts   Occurrences of each ASCII character in the traffic
+ * @param units    Total airtime in units upon return, counting the gap
+ *                 after each character
+ *
+ * @return 0 on success, or -1 on invalid parameters or if a character
+ *         with a non-zero count has no code word
+ *
+ * @note Spaces are ignored, as word gaps do not depend on the code
+ */
+int morse_alphabet_airtime(const morse_alphabet_td *alphabet,
+        const unsigned long counts[MORSE_ALPHABET_SYMBOLS], uint64_t *units);
+
+/**
+ * @brief Write an alphabet as text, one symbol and code word per line
+ *
+ * @param alphabet Alphabet to write
+ * @param stream   Output stream
+ *
+ * @return 0 on success, or -1 on invalid parameters or write errors
+ *
+ * @note Each line holds the symbol, a space and its code word written
+ *       with @e MORSE_DIT and @e MORSE_DAH, e.g., "A .-"
+ */
+int morse_alphabet_save(const morse_alphabet_td *alphabet, FILE *stream);
+
+/**
+ * @brief Read an alphabet written by @e morse_alphabet_save
+ *
+ * @param alphabet Alphabet where the definition is stored
+ * @param stream   Input stream
+ *
+ * @return 0 on success, or -1 on invalid parameters, read errors or
+ *         malformed, duplicated or too long entries
+ *
+ * @note Empty lines and lines starting with '#' are ignored
+ */
+int morse_alphabet_load(morse_alphabet_td *alphabet, FILE *stream);
+
+
+#endif  /* ! MORSE_ALPHABET_H */
@@ -0,0 +1,113 @@
+/**
+ * @file morse_cache.h
+ *
+ * @brief Bounded cache of decoded words, keyed on their Morse characters
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+#ifndef MORSE_CACHE_H
+#define MORSE_CACHE_H
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Macros */
+#define MORSE_CACHE_WORD_MAX (16)   /* Max. characters of a cached word */
+#define MORSE_CACHE_KEY_MAX (64)    /* Max. Morse characters of its key */
+
+
+/**
+ * @brief Decoded word, stored along with the Morse characters it comes from
+ */
+typedef struct {
+    uint32_t hash;                      /**< Hash of the key */
+    uint8_t key_len;                    /**< Length of the key, 0 if unused */
+    uint8_t flags;                      /**< Parsing flags of the key */
+    uint8_t length;                     /**< Characters in @e word */
+    char key[MORSE_CACHE_KEY_MAX];      /**< Morse characters of the word */
+    char word[MORSE_CACHE_WORD_MAX];    /**< Decoded characters */
+} morse_cache_entry_td;
+
+/**
+ * @brief Direct-mapped cache of decoded words
+ */
+typedef struct {
+    morse_cache_entry_td *entries;  /**< Slots of the cache */
+    size_t mask;                    /**< Number of slots minus one */
+    unsigned long hits;             /**< Lookups found in the cache */
+    unsigned long misses;           /**< Lookups not found in the cache */
+} morse_cache_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize a new cache of decoded words
+ *
+ * @param capacity Number of words that fit in the cache, rounded up to
+ *                 the next power of two
+ *
+ * @return New allocated cache, or @c NULL on memory errors or if
+ *         @p capacity can't be rounded up to a power of two
+ *
+ * @note A cache holds words decoded with a given tree or alphabet, so
+ *       it must not be shared between different codes
+ * @note Every lookup updates the cache, so it must not be shared between
+ *       threads either
+ */
+morse_cache_td *morse_cache_init(size_t capacity);
+
+/**
+ * @brief Destroy the cache
+ *
+ * @param cache Cache to destroy
+ */
+void morse_cache_destroy(morse_cache_td *cache);
+
+/**
+ * @brief Look up a word by its Morse characters
+ *
+ * @param cache   Cache to look up in
+ * @param key     Morse characters of the word, as received
+ * @param key_len Number of characters in @p key
+ * @param flags   Parsing flags the word is decoded with
+ * @param length  Number of characters of the word upon return
+ *
+ * @return Characters of the word (not null-terminated), or @c NULL if
+ *         the word is not in the cache
+ *
+ * @note Complexity: @e O(n), where @e n is @p key_len
+ */
+const char *morse_cache_lookup(morse_cache_td *cache,
+        const char *key, size_t key_len, uint8_t flags, size_t *length);
+
+/**
+ * @brief Insert a decoded word, replacing the one in the same slot
+ *
+ * @param cache   Cache to insert the word into
+ * @param key     Morse characters of the word, as received
+ * @param key_len Number of characters in @p key
+ * @param flags   Parsing flags the word was decoded with
+ * @param word    Decoded characters
+ * @param length  Number of decoded characters
+ *
+ * @return 0 on success, or -1 if the word or its key are too long to be
+ *         cached
+ */
+int morse_cache_insert(morse_cache_td *cache, const char *key,
+        size_t key_len, uint8_t flags, const char *word, size_t length);
+
+/**
+ * @brief Macro that evaluates to the number of lookups that hit
+ */
+#define morse_cache_hits(cache) ((cache)->hits)
+
+/**
+ * @brief Macro that evaluates to the number of lookups that missed
+ */
+#define morse_cache_misses(cache) ((cache)->misses)
+
+
+#endif  /* ! MORSE_CACHE_H */
@@ -0,0 +1,211 @@
+/**
+ * @file morse_ctc.h
+ *
+ * @brief Chinese telegraph code: conversion between Hanzi and the
+ *        4-digit groups sent over Morse
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+/* Chinese telegraph code
+ *
+ * Each Hanzi is sent as a group of four digits (0000 to 9999) taken
+ * from a code book, e.g., "中" is 0022 and "文" is 2429.  Sending is
+ * then done in two stages: characters are replaced by their groups,
+ * which are plain digits for the Morse alphabet, and receiving goes
+ * the other way round.
+ *
+ * The code book is not part of this library: it is built from a list
+ * of (character, group) pairs.  Characters are found with a minimal
+ * perfect hash (hash and displace), and groups with a table indexed by
+ * their value, so both directions take constant time per character.
+ * All the tables live in a single block without pointers, which can be
+ * saved to a file and used in place, e.g., after mapping the file into
+ * memory, without parsing or rebuilding anything.
+ */
+
+#ifndef MORSE_CTC_H
+#define MORSE_CTC_H
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <stdio.h>  /* FILE */
+
+
+/* Macros */
+#define MORSE_CTC_CODES (10000)         /* Groups from 0000 to 9999 */
+#define MORSE_CTC_DIGITS (4)            /* Digits in a group */
+#define MORSE_CTC_MAGIC (0x4354434Du)   /* "MCTC", little-endian */
+#define MORSE_CTC_VERSION (1)
+
+
+/**
+ * @brief Header of the block holding the tables of a code book
+ *
+ * It's followed by the displacement of every bucket (@e int32_t), the
+ * character in every slot (@e uint32_t), the character of every group
+ * (@e MORSE_CTC_CODES @e uint32_t, 0 if unused) and the group in every
+ * slot (@e uint16_t).
+ */
+typedef struct {
+    uint32_t magic;         /**< @e MORSE_CTC_MAGIC */
+    uint32_t version;       /**< @e MORSE_CTC_VERSION */
+    uint32_t count;         /**< Characters (and slots) in the book */
+    uint32_t n_buckets;     /**< Buckets of the perfect hash */
+} morse_ctc_header_td;
+
+/**
+ * @brief Chinese telegraph code book
+ */
+typedef struct {
+    const morse_ctc_header_td *header;  /**< Start of the tables */
+    const int32_t *displacement;        /**< Seed or slot per bucket */
+    const uint32_t *codepoints;         /**< Character in each slot */
+    const uint32_t *reverse;            /**< Character of each group */
+    const uint16_t *codes;              /**< Group in each slot */
+    size_t size;                        /**< Bytes in the tables */
+    void *owned;                        /**< Tables to free, if any */
+} morse_ctc_td;
+
+
+/* Public interface */
+/**
+ * @brief Build a code book from a list of characters and their groups
+ *
+ * @param codepoints Unicode code points of the characters, not ASCII
+ * @param codes      Group of each character, from 0 to 9999
+ * @param count      Number of characters
+ *
+ * @return New allocated code book, or @c NULL on invalid parameters
+ *         (including ASCII characters, surrogates and values above
+ *         U+10FFFF), repeated characters or groups, or on memory errors
+ *
+ * @note Complexity: expected @e O(n), where @e n is @p count
+ */
+morse_ctc_td *morse_ctc_build(const uint32_t *codepoints,
+        const uint16_t *codes, size_t count);
+
+/**
+ * @brief Build a code book from a text list of groups and characters
+ *
+ * @param stream Input stream with a group, a space and a character in
+ *               UTF-8 per line, e.g., "0022 中"
+ *
+ * @return New allocated code book, or @c NULL on malformed input or
+ *         on errors as in @e morse_ctc_build
+ *
+ * @note Empty lines and lines starting with '#' are ignored
+ */
+morse_ctc_td *morse_ctc_load(FILE *stream);
+
+/**
+ * @brief Use in place the tables of a code book written by
+ *        @e morse_ctc_save
+ *
+ * @param data Tables of the code book, aligned to 4 bytes, e.g., a
+ *             file mapped into memory
+ * @param size Size of @p data in bytes
+ *
+ * @return New code book pointing into @p data, or @c NULL if the
+ *         tables are not valid
+ *
+ * @note @p data is neither copied nor freed, and it must remain valid
+ *       until the code book is destroyed
+ * @note Only the header is checked here; the character of a group is
+ *       checked when it's looked up
+ * @note Complexity: @e O(1)
+ */
+morse_ctc_td *morse_ctc_map(const void *data, size_t size);
+
+/**
+ * @brief Write the tables of a code book, to be used with
+ *        @e morse_ctc_map
+ *
+ * @param ctc    Code book
+ * @param stream Output stream, opened in binary mode
+ *
+ * @return 0 on success, or -1 on invalid parameters or write errors
+ */
+int morse_ctc_save(const morse_ctc_td *ctc, FILE *stream);
+
+/**
+ * @brief Destroy a code book
+ *
+ * @param ctc Code book to destroy
+ */
+void morse_ctc_destroy(morse_ctc_td *ctc);
+
+/**
+ * @brief Get the group of a character
+ *
+ * @param ctc       Code book
+ * @param codepoint Unicode code point of the character
+ *
+ * @return Group of the character, or -1 if it's not in the code book
+ *
+ * @note Complexity: @e O(1)
+ */
+int morse_ctc_code(const morse_ctc_td *ctc, uint32_t codepoint);
+
+/**
+ * @brief Get the character of a group
+ *
+ * @param ctc  Code book
+ * @param code Group, from 0 to 9999
+ *
+ * @return Unicode code point of the character, or 0 if the group is
+ *         not in the code book or its character is not valid (e.g., in
+ *         corrupted tables used with @e morse_ctc_map)
+ *
+ * @note Complexity: @e O(1)
+ */
+uint32_t morse_ctc_codepoint(const morse_ctc_td *ctc, unsigned code);
+
+/**
+ * @brief Replace every character of a UTF-8 text by its group
+ *
+ * @param ctc      Code book
+ * @param dst      Output buffer, ready to be encoded into Morse
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param dst_len  If not @c NULL, number of characters written to
+ *                 @p dst upon return, not counting the terminator
+ * @param src      UTF-8 text
+ * @param src_len  Number of bytes in @p src
+ *
+ * @return 0 on success, or -1 on invalid parameters, malformed UTF-8
+ *         or if @p dst is too small
+ *
+ * @note Groups are separated by spaces from anything else, ASCII
+ *       characters are copied unchanged, and other characters not in
+ *       the code book are dropped
+ */
+int morse_ctc_to_digits(const morse_ctc_td *ctc,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len);
+
+/**
+ * @brief Replace every group of a decoded text by its character
+ *
+ * @param ctc      Code book
+ * @param dst      Output buffer for the UTF-8 text
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param dst_len  If not @c NULL, number of bytes written to @p dst
+ *                 upon return, not counting the terminator
+ * @param src      Text decoded from Morse
+ * @param src_len  Number of characters in @p src
+ *
+ * @return 0 on success, or -1 on invalid parameters or if @p dst is
+ *         too small
+ *
+ * @note Every word made of exactly four digits that is a group of the
+ *       code book is replaced, and consecutive characters are joined
+ *       without spaces; any other word is copied unchanged
+ */
+int morse_ctc_from_digits(const morse_ctc_td *ctc,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len);
+
+
+#endif  /* ! MORSE_CTC_H */
@@ -0,0 +1,173 @@
+/**
+ * @file morse_registry.h
+ *
+ * @brief Registry of shared, reference-counted alphabets that can be
+ *        replaced while in use
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+/* Registry of alphabets
+ *
+ * Clients of a long-running process (e.g., a server) may each need a
+ * different alphabet or different flags.  Their instances are built
+ * once and stored by ID, so selecting one is an array access.  Every
+ * instance is reference-counted: a client acquires it for as long as a
+ * request lasts, and releases it afterwards.
+ *
+ * Replacing an instance publishes the new one with an atomic exchange,
+ * so requests started afterwards get it, while those in flight finish
+ * on the old one, which is freed when the last of them releases it.
+ * Acquiring takes no lock: clients in the middle of an acquisition pin
+ * the current epoch of the ID, and a replacement starts a new epoch and
+ * waits, yielding the processor, until none of those pinned in the
+ * previous one can still be taking a reference to the old instance.
+ * Clients arriving meanwhile pin the new epoch, so the wait is bounded
+ * by the acquisitions already under way.
+ *
+ * It relies on the GCC atomic builtins (also in Clang), on the POSIX
+ * monotonic clock and on 'sched_yield'.
+ */
+
+#ifndef MORSE_REGISTRY_H
+#define MORSE_REGISTRY_H
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <stdio.h>  /* FILE */
+
+/* Local includes */
+#include <morse_alphabet.h>
+
+
+/* Macros */
+#define MORSE_REGISTRY_MAX (64)     /* Number of IDs */
+
+
+/**
+ * @brief Alphabet shared by the clients with the same ID
+ */
+typedef struct {
+    morse_alphabet_td alphabet; /**< Tables of the alphabet */
+    uint8_t flags;              /**< Flags to encode and decode with */
+    unsigned long refs;         /**< References held, the registry's too */
+} morse_instance_td;
+
+/**
+ * @brief Registry of alphabets, by ID
+ */
+typedef struct {
+    morse_instance_td *instances[MORSE_REGISTRY_MAX];   /**< By ID */
+    unsigned long epochs[MORSE_REGISTRY_MAX];   /**< Replacements by ID */
+    unsigned long pins[MORSE_REGISTRY_MAX][2];  /**< Acquisitions ongoing,
+                                                     by parity of epoch */
+    unsigned char publishing[MORSE_REGISTRY_MAX];   /**< Replacing now */
+    unsigned long reloads;      /**< Instances replaced or added */
+    uint64_t last_reload;       /**< Nanoseconds of the last swap or load */
+    uint64_t max_reload;        /**< Nanoseconds of the slowest one */
+} morse_registry_td;
+
+
+/* Public interface */
+/**
+ * @brief Initialize a new, empty registry
+ *
+ * @return New allocated registry, or @c NULL otherwise
+ */
+morse_registry_td *morse_registry_init(void);
+
+/**
+ * @brief Destroy the registry, dropping its references
+ *
+ * @param registry Registry to destroy
+ *
+ * @note Instances still acquired are freed once released
+ */
+void morse_registry_destroy(morse_registry_td *registry);
+
+/**
+ * @brief Acquire the instance of an ID
+ *
+ * @param registry Registry
+ * @param id       ID of the instance
+ *
+ * @return Instance of @p id, to be released with
+ *         @e morse_registry_release, or @c NULL if there's none
+ *
+ * @note It may be called concurrently with any other function but
+ *       @e morse_registry_destroy
+ * @note Complexity: @e O(1)
+ */
+const morse_instance_td *morse_registry_acquire(morse_registry_td *registry,
+        unsigned id);
+
+/**
+ * @brief Release an instance acquired with @e morse_registry_acquire
+ *
+ * @param instance Instance to release
+ */
+void morse_registry_release(const morse_instance_td *instance);
+
+/**
+ * @brief Replace the instance of an ID with a copy of an alphabet
+ *
+ * @param registry Registry
+ * @param id       ID of the instance
+ * @param alphabet Alphabet of the new instance, or @c NULL to remove
+ *                 the instance of @p id
+ * @param flags    Flags of the new instance, e.g.,
+ *                 @e MORSE_USE_SEPARATORS
+ *
+ * @return 0 on success, or -1 on invalid parameters or memory errors
+ *
+ * @note The previous instance is freed when its last client releases
+ *       it, or right away if it's not acquired
+ * @note The time it takes, from copying to publishing, is measured on
+ *       the monotonic clock
+ *
+ * @see morse_registry_last_reload
+ */
+int morse_registry_swap(morse_registry_td *registry, unsigned id,
+        const morse_alphabet_td *alphabet, uint8_t flags);
+
+/**
+ * @brief Read an alphabet and replace the instance of an ID with it
+ *
+ * @param registry Registry
+ * @param id       ID of the instance
+ * @param stream   Input stream, as in @e morse_alphabet_load
+ * @param flags    Flags of the new instance
+ *
+ * @return 0 on success, or -1 on invalid parameters, on malformed
+ *         input (leaving the instance of @p id untouched) or on memory
+ *         errors
+ *
+ * @note The time it takes, from reading to publishing, is measured on
+ *       the monotonic clock
+ *
+ * @see morse_registry_last_reload
+ */
+int morse_registry_load(morse_registry_td *registry, unsigned id,
+        FILE *stream, uint8_t flags);
+
+/**
+ * @brief Macro that evaluates to the number of reloads
+ */
+#define morse_registry_reloads(registry) ((registry)->reloads)
+
+/**
+ * @brief Macro that evaluates to the time of the last swap or load, in
+ *        nanoseconds
+ */
+#define morse_registry_last_reload(registry) ((registry)->last_reload)
+
+/**
+ * @brief Macro that evaluates to the time of the slowest swap or load,
+ *        in nanoseconds
+ */
+#define morse_registry_max_reload(registry) ((registry)->max_reload)
+
+
+#endif  /* ! MORSE_REGISTRY_H */
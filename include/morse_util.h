@@ -0,0 +1,80 @@
+/**
+ * @file morse_util.h
+ *
+ * @brief Helpers shared by the encoders and decoders: bounded output,
+ *        UTF-8 and code words being received
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+/* Internal helpers
+ *
+ * These are used by the library itself, and they are not part of its
+ * public interface.
+ */
+
+#ifndef MORSE_UTIL_H
+#define MORSE_UTIL_H
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Macros */
+#define MORSE_UTF8_CODEPOINT_MAX (0x10FFFFu)    /* Largest code point */
+#define MORSE_UTF8_LENGTH_MAX (4)       /* Bytes of a code point in UTF-8 */
+
+
+/**
+ * @brief Append bytes to a bounded output, keeping it null-terminated
+ *
+ * @param dst      Output buffer
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param len      Bytes in @p dst, updated upon return
+ * @param src      Bytes to append
+ * @param n        Number of bytes in @p src
+ *
+ * @return 0 on success, or -1 if they don't fit, leaving @p dst as is
+ */
+int morse_util_put(char *dst, size_t dst_size, size_t *len,
+        const char *src, size_t n);
+
+/**
+ * @brief Decode a UTF-8 sequence
+ *
+ * @param src       UTF-8 bytes
+ * @param len       Number of bytes in @p src
+ * @param codepoint Code point of the sequence upon return
+ *
+ * @return Length of the sequence, or 0 if it's malformed, including
+ *         overlong forms, surrogates and values above U+10FFFF
+ */
+size_t morse_util_utf8_decode(const unsigned char *src, size_t len,
+        uint32_t *codepoint);
+
+/**
+ * @brief Encode a code point in UTF-8
+ *
+ * @param codepoint Code point, up to U+10FFFF
+ * @param dst       Output of up to @e MORSE_UTF8_LENGTH_MAX bytes, not
+ *                  null-terminated
+ *
+ * @return Length of the sequence
+ */
+size_t morse_util_utf8_encode(uint32_t codepoint, char *dst);
+
+/**
+ * @brief Append an element to the heap index of a code word being
+ *        received
+ *
+ * @param code   Heap index received so far, 1 if none
+ * @param is_dah Whether the element is a 'dah'
+ *
+ * @return New heap index, or @e MORSE_ALPHABET_NO_CODE once the code
+ *         word is too long, which remains so with more elements
+ */
+unsigned morse_util_code_push(unsigned code, bool is_dah);
+
+
+#endif  /* ! MORSE_UTIL_H */
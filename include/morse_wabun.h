@@ -0,0 +1,206 @@
+/**
+ * @file morse_wabun.h
+ *
+ * @brief Wabun code: Japanese kana and Latin characters in the same
+ *        stream, switching alphabets with prosigns
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+/* Wabun code
+ *
+ * The same code word means a Latin character or a kana depending on the
+ * current mode, e.g., '.-' is 'A' or 'イ'.  Traffic starts in Latin
+ * mode; the prosign <DO> (-..---) switches to kana, and <SN> (...-.)
+ * switches back.
+ *
+ * Each mode has its own tables, indexed directly by the character (its
+ * ASCII value, or its offset in the CJK symbols, hiragana and katakana
+ * blocks, from U+3000 to U+30FF) and by the heap index of the code word.
+ * The prosigns are entries of the decoding tables too, so every
+ * character costs a single lookup in both directions.
+ *
+ * Text is encoded and decoded as a stream of chunks, and everything
+ * carried from one chunk to the next is kept in a small state without
+ * pointers, which can be packed into bytes, e.g., to resume a decoding
+ * in another process.
+ */
+
+#ifndef MORSE_WABUN_H
+#define MORSE_WABUN_H
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Local includes */
+#include <morse_alphabet.h>
+
+
+/* Macros */
+#define MORSE_WABUN_LATIN (0)           /* Latin mode */
+#define MORSE_WABUN_KANA (1)            /* Kana mode */
+#define MORSE_WABUN_MODES (2)
+#define MORSE_WABUN_SYMBOLS (256)       /* ASCII, or U+3000 to U+30FF */
+#define MORSE_WABUN_KANA_FIRST (0x3000) /* First character in kana mode */
+#define MORSE_WABUN_STATE_SIZE (4)      /* Bytes of a packed state */
+
+
+/**
+ * @brief Tables of the Wabun code
+ */
+typedef struct {
+    /** Code words of each character in each mode, the first one in the
+     * low byte and the second one, if any, in the high byte (e.g., a
+     * voiced kana is its base kana followed by the voicing mark) */
+    uint16_t code[MORSE_WABUN_MODES][MORSE_WABUN_SYMBOLS];
+
+    /** Code point of the character of each code word in each mode, 0 if
+     * none, or a shift to another mode */
+    uint16_t symbol[MORSE_WABUN_MODES][MORSE_ALPHABET_CODES];
+} morse_wabun_td;
+
+/**
+ * @brief State of the encoding or the decoding of a stream
+ */
+typedef struct {
+    uint8_t mode;   /**< @e MORSE_WABUN_LATIN or @e MORSE_WABUN_KANA */
+    uint8_t code;   /**< Code word being received, 1 if none */
+    uint8_t spaces; /**< Spaces received after the last element */
+    uint8_t gap;    /**< Gap due before the next character */
+} morse_wabun_state_td;
+
+
+/* Public interface */
+/**
+ * @brief Build the tables of the Wabun code
+ *
+ * @param wabun Tables to build
+ * @param latin Alphabet of the Latin mode, e.g., one built by
+ *              @e morse_alphabet_from_tree
+ *
+ * @return 0 on success, or -1 on invalid parameters or if the code
+ *         words of the prosigns are characters of @p latin
+ *
+ * @note Kana mode takes katakana and hiragana, sending small kana as
+ *       full-size ones, and voiced kana as their base kana followed by
+ *       the mark (゛ or ゜); it's decoded into katakana
+ */
+int morse_wabun_init(morse_wabun_td *wabun, const morse_alphabet_td *latin);
+
+/**
+ * @brief Start the encoding or the decoding of a stream in Latin mode
+ *
+ * @param state State of the stream
+ */
+void morse_wabun_state_init(morse_wabun_state_td *state);
+
+/**
+ * @brief Pack the state of a stream into bytes
+ *
+ * @param state State of the stream
+ * @param bytes Output bytes
+ */
+void morse_wabun_state_pack(const morse_wabun_state_td *state,
+        uint8_t bytes[MORSE_WABUN_STATE_SIZE]);
+
+/**
+ * @brief Unpack the state of a stream from bytes
+ *
+ * @param state State of the stream upon return
+ * @param bytes Bytes written by @e morse_wabun_state_pack
+ *
+ * @return 0 on success, or -1 if @p bytes is not a valid state
+ */
+int morse_wabun_state_unpack(morse_wabun_state_td *state,
+        const uint8_t bytes[MORSE_WABUN_STATE_SIZE]);
+
+/**
+ * @brief Encode a chunk of UTF-8 text, switching modes as needed
+ *
+ * @param wabun    Tables of the Wabun code
+ * @param state    State of the stream, updated upon return
+ * @param dst      Output buffer for Morse characters
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param dst_len  If not @c NULL, number of characters written to
+ *                 @p dst upon return, not counting the terminator
+ * @param src      UTF-8 text, not splitting any character
+ * @param src_len  Number of bytes in @p src
+ * @param src_used If not @c NULL, number of bytes of @p src encoded
+ *                 upon return
+ * @param flags    Formatting flags:
+ *      - @e MORSE_NO_FLAGS: do not use any flag
+ *      - @e MORSE_USE_SEPARATORS: use separators, as @e morse_encode
+ *
+ * @return 0 on success, 1 if @p dst is full before the end of @p src,
+ *         or -1 on invalid parameters or malformed UTF-8
+ *
+ * @note Characters without a code word in their mode are skipped, and
+ *       the gap before the next character is kept in @p state, so the
+ *       chunks of a stream may be joined as they come
+ * @note When @p dst is full, it holds the code words of the characters
+ *       that fit, and @p src_used stops before the first one that
+ *       didn't, so the encoding goes on from there with the same
+ *       @p state once @p dst is drained; 64 bytes always fit a
+ *       character, with its gap and shift
+ * @note On malformed UTF-8, @p dst, @p dst_len, @p src_used and
+ *       @p state are left as when @p dst is full, stopping before the
+ *       malformed sequence
+ */
+int morse_wabun_encode(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, size_t *src_used, uint8_t flags);
+
+/**
+ * @brief Decode a chunk of Morse characters, following the prosigns
+ *        that switch modes
+ *
+ * @param wabun    Tables of the Wabun code
+ * @param state    State of the stream, updated upon return
+ * @param dst      Output buffer for UTF-8 text
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param dst_len  If not @c NULL, number of bytes written to @p dst
+ *                 upon return, not counting the terminator
+ * @param src      Morse characters, split anywhere
+ * @param src_len  Number of characters in @p src
+ * @param src_used If not @c NULL, number of characters of @p src
+ *                 decoded upon return
+ * @param flags    Parsing flags, as in @e morse_decode
+ *
+ * @return 0 on success, 1 if @p dst is full before the end of @p src,
+ *         or -1 on invalid parameters
+ *
+ * @note The last character of a chunk is not decoded until a gap
+ *       follows it, in this chunk or in the next one
+ * @note When @p dst is full, it holds the characters that fit, and
+ *       @p src_used stops at the element that would have completed the
+ *       next one, so the decoding goes on from there with the same
+ *       @p state once @p dst is drained; 5 bytes always fit a
+ *       character, with its gap
+ *
+ * @see morse_wabun_decode_flush
+ */
+int morse_wabun_decode(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, size_t *src_used, uint8_t flags);
+
+/**
+ * @brief Decode the character pending at the end of a stream
+ *
+ * @param wabun    Tables of the Wabun code
+ * @param state    State of the stream, updated upon return
+ * @param dst      Output buffer for UTF-8 text
+ * @param dst_size Capacity of @p dst, terminator included
+ * @param dst_len  If not @c NULL, number of bytes written to @p dst
+ *                 upon return, not counting the terminator
+ *
+ * @return 0 on success, 1 if @p dst is too small, leaving @p state
+ *         untouched, or -1 on invalid parameters
+ */
+int morse_wabun_decode_flush(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len);
+
+
+#endif  /* ! MORSE_WABUN_H */
@@ -18,6 +18,34 @@
 #include <adt/bistree.h>
 
 
+/* Number of searches advanced in lockstep by 'bistree_lookup_many' */
+#define BISTREE_LOOKUP_GROUP (8)
+
+/* Hint the processor to start loading an address into the cache */
+#if defined(__GNUC__)
+#define _prefetch(addr) __builtin_prefetch(addr)
+#else
+#define _prefetch(addr) ((void) (addr))
+#endif
+
+
+/* Stages of a single search in a batched lookup */
+typedef enum {
+    LOOKUP_LOAD_AVL,    /**< Node is being fetched, read its AVL data */
+    LOOKUP_LOAD_KEY,    /**< AVL data is being fetched, read its key */
+    LOOKUP_COMPARE,     /**< Key is being fetched, compare and descend */
+    LOOKUP_DONE         /**< Search finished */
+} lookup_stage_td;
+
+
+/* State of a single search in a batched lookup */
+typedef struct {
+    size_t index;               /**< Index of the key being searched */
+    bitree_node_td *node;       /**< Current node */
+    lookup_stage_td stage;      /**< Next step to perform */
+} lookup_cursor_td;
+
+
 static void _destroy_right(bitree_td *tree, bitree_node_td *node);
 
 
@@ -414,6 +442,71 @@ static int _lookup(bitree_td *tree, bitree_node_td *node, void **data)
 }
 
 
+/* Move a cursor down to a child, prefetching the child node */
+static void _cursor_descend(lookup_cursor_td *cursor, bitree_node_td *node,
+        int *status)
+{
+    if (bitree_is_eob(node)) {
+        /* Return that the data was not found */
+        status[cursor->index] = -1;
+        cursor->stage = LOOKUP_DONE;
+        return;
+    }
+
+    _prefetch(node);
+    cursor->node = node;
+    cursor->stage = LOOKUP_LOAD_AVL;
+}
+
+
+/* Advance a cursor by one stage; return 1 if the search just finished */
+static int _cursor_step(bitree_td *tree, lookup_cursor_td *cursor,
+        void **data, int *status)
+{
+    avl_node_td *avl_data;
+    int cmpval;
+
+    switch (cursor->stage) {
+        case LOOKUP_LOAD_AVL:
+            _prefetch(bitree_data(cursor->node));
+            cursor->stage = LOOKUP_LOAD_KEY;
+            return 0;
+
+        case LOOKUP_LOAD_KEY:
+            _prefetch(((avl_node_td *) bitree_data(cursor->node))->data);
+            cursor->stage = LOOKUP_COMPARE;
+            return 0;
+
+        case LOOKUP_COMPARE:
+            avl_data = bitree_data(cursor->node);
+            cmpval = tree->compare(data[cursor->index], avl_data->data);
+
+            if (cmpval < 0) {
+                /* Move to the left */
+                _cursor_descend(cursor, bitree_left(cursor->node), status);
+            } else if (cmpval > 0) {
+                /* Move to the right */
+                _cursor_descend(cursor, bitree_right(cursor->node), status);
+            } else if (!avl_data->is_hidden) {
+                /* Pass back the data from the tree */
+                data[cursor->index] = avl_data->data;
+                status[cursor->index] = 0;
+                cursor->stage = LOOKUP_DONE;
+            } else {
+                /* Return that the data was not found */
+                status[cursor->index] = -1;
+                cursor->stage = LOOKUP_DONE;
+            }
+
+            return cursor->stage == LOOKUP_DONE;
+
+        case LOOKUP_DONE:
+        default:
+            return 0;
+    }
+}
+
+
 /* Initialize a new binary search tree */
 bistree_td *bistree_init(int (*compare)(const void *key1,
             const void *key2), void (*destroy)(void *data))
@@ -462,3 +555,47 @@ int bistree_lookup(bistree_td *tree, void **data)
 {
     return _lookup(tree, bitree_root(tree), data);
 }
+
+
+/* Determine whether several nodes match the specified data */
+size_t bistree_lookup_many(bistree_td *tree, void **data, int *status,
+        size_t count)
+{
+    lookup_cursor_td cursors[BISTREE_LOOKUP_GROUP];
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += BISTREE_LOOKUP_GROUP) {
+        size_t group = count - base;
+        size_t active = 0;
+
+        if (group > BISTREE_LOOKUP_GROUP) {
+            group = BISTREE_LOOKUP_GROUP;
+        }
+
+        /* Start every search of the group at the root */
+        for (size_t i = 0; i < group; ++i) {
+            cursors[i].index = base + i;
+            _cursor_descend(&cursors[i], bitree_root(tree), status);
+            if (cursors[i].stage != LOOKUP_DONE) {
+                ++active;
+            }
+        }
+
+        /* Interleave the searches, so that the memory accesses issued
+         * by one of them overlap with the work done by the others */
+        while (active > 0) {
+            for (size_t i = 0; i < group; ++i) {
+                active -= (size_t) _cursor_step(tree, &cursors[i],
+                        data, status);
+            }
+        }
+
+        for (size_t i = 0; i < group; ++i) {
+            if (status[base + i] == 0) {
+                ++found;
+            }
+        }
+    }
+
+    return found;
+}
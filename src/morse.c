@@ -12,31 +12,88 @@
 
 /* System includes */
 #include <ctype.h>  /* isspace, toupper */
+#include <limits.h> /* CHAR_BIT */
 #include <stdlib.h> /* malloc, free, NULL */
-#include <string.h> /* strchr */
+#include <string.h> /* memcmp, memset, strlen */
 
 /* ADT includes */
 #include <adt/bistree.h>
 
 /* Local includes */
 #include <morse.h>
+#include <morse_alphabet.h>
+#include <morse_cache.h>
+#include <morse_util.h>
 
 
-/* Compare two characters to get their order according to the Morse code */
-static int s_compare(const void *key1, const void *key2)
+/**
+ * @brief Bounded output buffer, always kept null-terminated
+ */
+typedef struct {
+    char *data;     /**< Caller-provided storage */
+    size_t size;    /**< Capacity of @e data, terminator included */
+    size_t len;     /**< Characters written so far */
+} morse_buffer_td;
+
+
+/**
+ * @brief Position (1-based) of each character in @e MORSE_WEIGHTED_NODES
+ *
+ * A zero entry means that the character is not part of the Morse tree.
+ * The table spans two cache lines, so comparing two keys costs two
+ * loads instead of two linear scans of @e MORSE_WEIGHTED_NODES.  It's
+ * constant, so trees may be built and used from several threads at
+ * once, and @e morse_init checks it against @e MORSE_WEIGHTED_NODES.
+ */
+static const int8_t s_morse_rank[128] = {
+    ['5'] =  1, ['H'] =  2, ['4'] =  3, ['S'] =  4, ['V'] =  5,
+    ['3'] =  6, ['I'] =  7, ['F'] =  8, ['U'] =  9, ['['] = 10,
+    ['2'] = 11, ['E'] = 12, ['L'] = 13, ['R'] = 14, ['+'] = 15,
+    [']'] = 16, ['A'] = 17, ['P'] = 18, ['W'] = 19, ['J'] = 20,
+    ['1'] = 21, ['~'] = 22, ['6'] = 23, ['B'] = 24, ['='] = 25,
+    ['D'] = 26, ['/'] = 27, ['X'] = 28, ['N'] = 29, ['C'] = 30,
+    ['K'] = 31, ['Y'] = 32, ['T'] = 33, ['7'] = 34, ['Z'] = 35,
+    ['G'] = 36, ['Q'] = 37, ['M'] = 38, ['8'] = 39, ['('] = 40,
+    ['O'] = 41, ['9'] = 42, [')'] = 43, ['0'] = 44
+};
+
+
+/* Check that the table of positions matches the Morse weighted order,
+ * reading both only */
+static bool s_rank_check(void)
 {
-    int64_t pos1 = strchr(MORSE_WEIGHTED_NODES,
-            toupper(*(char *) key1)) - MORSE_WEIGHTED_NODES;
-    int64_t pos2 = strchr(MORSE_WEIGHTED_NODES,
-            toupper(*(char *) key2)) - MORSE_WEIGHTED_NODES;
+    const char *nodes = MORSE_WEIGHTED_NODES;
+    size_t ranked = 0;
+    size_t i;
 
-    if (pos1 > pos2) {
-        return 1;
-    } else if (pos1 < pos2) {
-        return -1;
+    for (size_t c = 0; c < sizeof(s_morse_rank); ++c) {
+        ranked += (s_morse_rank[c] != 0);
     }
 
-    return 0;
+    for (i = 0; nodes[i] != '\0'; ++i) {
+        if ((unsigned char) nodes[i] >= sizeof(s_morse_rank) ||
+                s_morse_rank[(unsigned char) nodes[i]] != (int8_t) (i + 1)) {
+            return false;
+        }
+    }
+
+    return i == ranked;
+}
+
+
+/* Get the position of a character in the Morse weighted order */
+static int s_rank(int c)
+{
+    c = toupper((unsigned char) c);
+
+    return (c >= 0 && c < 128) ? s_morse_rank[c] : 0;
+}
+
+
+/* Compare two characters to get their order according to the Morse code */
+static int s_compare(const void *key1, const void *key2)
+{
+    return s_rank(*(const char *) key1) - s_rank(*(const char *) key2);
 }
 
 
@@ -119,298 +176,564 @@ static void s_morse_generate_nodes(morse_tree_td *morse)
 }
 
 
-/* Lookup in the Morse tree and get a string with the Morse code */
+/* Append @p len characters of @p str to a bounded output buffer */
+static int s_buffer_append(morse_buffer_td *buf, const char *str,
+        size_t len)
+{
+    return morse_util_put(buf->data, buf->size, &buf->len, str, len);
+}
+
+
+/* Append a single character to a bounded output buffer */
+static int s_buffer_put(morse_buffer_td *buf, char c)
+{
+    return s_buffer_append(buf, &c, 1);
+}
+
+
+/* Append a 'dit' or a 'dah', and the element separator if requested */
+static int s_buffer_element(morse_buffer_td *buf, bool is_dah,
+        bool use_separators)
+{
+    if (is_dah) {
+        if (s_buffer_append(buf, MORSE_DAH, strlen(MORSE_DAH)) != 0) {
+            return -1;
+        }
+    } else {
+        if (s_buffer_append(buf, MORSE_DIT, strlen(MORSE_DIT)) != 0) {
+            return -1;
+        }
+    }
+
+    if (use_separators) {
+        return s_buffer_append(buf, MORSE_SEP, strlen(MORSE_SEP));
+    }
+
+    return 0;
+}
+
+
+/* Lookup in the Morse tree and get the code word of a character */
 /**
- * @brief Encode a single character into its Morse string
+ * @brief Encode a single character into its code word
  *
- * @param morse Morse tree
- * @param node  Node of the tree to start to look for the character in
- * @param data  Pointer to a data node containing character to look for
- * @param dst   Pointer to the string with the Morse coded character
+ * @param codec Morse tree
+ * @param c     Character to look for
+ * @param code  Heap index of the code word of @p c upon return
  *
  * @return Status of the lookup operation
- * @retval 0 The character is on the Morse tree, or otherwise
+ * @retval  0 The character is on the Morse tree
+ * @retval  1 The character is not encoded (filler or unknown), so it
+ *            must be skipped
+ * @retval -1 The character could not be found (hidden node)
  *
- * @note If the character is found, @e dst points to the matching string
- * @note If the character is not found, @e dst points to an empty string
+ * @note Each step to the left adds a 'dit' to the code word and each
+ *       step to the right adds a 'dah'
  * @note Since this is a lookup operation, the complexity of this
  *       function is @e O(log n), where @e n is the number of nodes in
  *       the binary tree specified by @e MORSE_MAX_NODES
  */
-static int s_morse_encode_char(const morse_tree_td *morse,
-        const bitree_node_td *node, const char *data, char *dst,
-        bool use_separators)
+static int s_morse_encode_char(const void *codec, char c, unsigned *code)
 {
+    const morse_tree_td *morse = codec;
+    const bitree_node_td *node;
     int cmpval;
 
-    if (bitree_is_eob(node)) {
-        /* Return that the data was not found */
-        return -1;
+    /* Ignore filler characters and those not in the tree */
+    if (c == '~' || c == '(' || c == ')' || c == '[' || c == ']' ||
+            s_rank(c) == 0) {
+        return 1;
     }
 
-    cmpval = morse->compare(data, bistree_data(node));
-    if (cmpval < 0) {
-        /* Move to the left after adding a 'dit' (dot) */
-        strcat(dst, MORSE_DIT);
-        if (use_separators) {
-            strcat(dst, MORSE_SEP);
-        }
-        return s_morse_encode_char(morse, bitree_left(node), data, dst,
-                use_separators);
-    } else if (cmpval > 0) {
-        /* Move to the right after adding a 'dah' (dash) */
-        strcat(dst, MORSE_DAH);
-        if (use_separators) {
-            strcat(dst, MORSE_SEP);
+    *code = 1;
+    for (node = bitree_root(morse); !bitree_is_eob(node);) {
+        cmpval = morse->compare(&c, bistree_data(node));
+        if (cmpval < 0) {
+            /* Move to the left after adding a 'dit' (dot) */
+            *code <<= 1;
+            node = bitree_left(node);
+        } else if (cmpval > 0) {
+            /* Move to the right after adding a 'dah' (dash) */
+            *code = (*code << 1) | 1;
+            node = bitree_right(node);
+        } else {
+            return bistree_is_hidden(node) ? -1 : 0;
         }
-        return s_morse_encode_char(morse, bitree_right(node), data, dst,
-                use_separators);
     }
 
-    /* cmpval == 0 */
-    if (!(bistree_is_hidden(node))) {
-        return 0;
-    } else {
-        /* Return that the data was not found */
-        return -1;
+    /* Return that the data was not found */
+    return -1;
+}
+
+
+/* Encode a character using the tables of an alphabet */
+static int s_alphabet_encode_char(const void *codec, char c, unsigned *code)
+{
+    const morse_alphabet_td *alphabet = codec;
+    int key = toupper((unsigned char) c);
+
+    if (key < 0 || key >= MORSE_ALPHABET_SYMBOLS ||
+            alphabet->code[key] == MORSE_ALPHABET_NO_CODE) {
+        return 1;
     }
+
+    *code = alphabet->code[key];
+    return 0;
 }
 
 
 /**
- * @brief Decode a single Morse string into its character
+ * @brief Decode a single code word into its character
  *
- * @param morse     Morse tree
- * @param morse_str String with the Morse code for one character
- * @param dst       Pointer to a char where the decoded character will
- *                  be stored
+ * @param codec Morse tree
+ * @param code  Heap index of the code word
+ * @param dst   Pointer to a char where the decoded character will
+ *              be stored
  *
  * @return Status of the lookup operation
  * @retval  0 The character was decoded successfully and stored in @p dst
  * @retval -1 The code is invalid (path does not exist or node is hidden)
  *
  * @note This function walks the same binary tree used for encoding:
- *       each 'dit' (@e MORSE_DIT[0]) moves to the left child and each
- *       'dah' (@e MORSE_DAH[0]) moves to the right child.
+ *       each 'dit' (a 0 bit of @p code) moves to the left child and each
+ *       'dah' (a 1 bit of @p code) moves to the right child.
  */
-static int s_morse_decode_char(const morse_tree_td *morse,
-        const char *morse_str, char *dst)
+static int s_morse_decode_char(const void *codec, unsigned code,
+        char *dst)
 {
+    const morse_tree_td *morse = codec;
     const bitree_node_td *node;
 
-    if (morse == NULL || morse_str == NULL || dst == NULL) {
+    /* The root is not a character */
+    if (code <= 1) {
         return -1;
     }
 
     node = bitree_root(morse);
-    if (bitree_is_eob(node)) {
+    for (unsigned i = morse_alphabet_length(code); i > 0; --i) {
+        if (bitree_is_eob(node)) {
+            return -1;
+        }
+
+        if ((code >> (i - 1)) & 1) {
+            node = bitree_right(node);
+        } else {
+            node = bitree_left(node);
+        }
+    }
+
+    if (bitree_is_eob(node) || bistree_is_hidden(node)) {
         return -1;
     }
 
-    for (size_t i = 0; morse_str[i] != '\0'; ++i) {
-        char c = morse_str[i];
+    *dst = *(char *) bistree_data(node);
+    return 0;
+}
 
-        /* Ignore separators characters if they appear inside the token */
-        if (c == MORSE_SEP[0]) {
-            continue;
-        } else if (c == MORSE_DIT[0]) {
-            node = bitree_left(node);
-        } else if (c == MORSE_DAH[0]) {
-            node = bitree_right(node);
-        } else {
-            /* Unexpected character in 'morse_str' */
+
+/* Decode a single code word using the tables of an alphabet */
+static int s_alphabet_decode_char(const void *codec, unsigned code,
+        char *dst)
+{
+    const morse_alphabet_td *alphabet = codec;
+
+    if (code >= MORSE_ALPHABET_CODES || alphabet->symbol[code] == '\0') {
+        return -1;
+    }
+
+    *dst = alphabet->symbol[code];
+    return 0;
+}
+
+
+/**
+ * @brief Character level operations of a Morse code representation
+ */
+typedef struct {
+    /**
+     * @brief Get the code word of a character
+     *
+     * @return 0 on success, 1 if the character has no code (so it's
+     *         skipped), or -1 on errors
+     */
+    int (*encode_char)(const void *codec, char c, unsigned *code);
+
+    /**
+     * @brief Decode the code word of a single character
+     *
+     * @return 0 on success, or -1 if the code word is invalid
+     */
+    int (*decode_char)(const void *codec, unsigned code, char *dst);
+} morse_codec_td;
+
+
+/**
+ * @brief State of the encoding of a message
+ */
+typedef struct {
+    morse_output_td *out;   /**< Requested outputs */
+    morse_buffer_td text;   /**< Morse text */
+    bool use_separators;    /**< Write separators in the text */
+    bool keyed;             /**< The key has been pressed already */
+    unsigned gap;           /**< Key-up units due before next element */
+} morse_encoder_td;
+
+
+/**
+ * @brief State of the decoding of a message
+ */
+typedef struct {
+    const morse_codec_td *ops;  /**< Operations of the codec */
+    const void *codec;          /**< Tree or alphabet */
+    morse_buffer_td out;        /**< Decoded text */
+    unsigned code;              /**< Code word being received */
+    bool has_token;             /**< Characters pending in the token */
+    bool truncated;             /**< Some character did not fit */
+} morse_decoder_td;
+
+/* Codec walking a Morse tree */
+static const morse_codec_td s_tree_codec = {
+    s_morse_encode_char, s_morse_decode_char
+};
+
+/* Codec using the tables of a Morse alphabet */
+static const morse_codec_td s_alphabet_codec = {
+    s_alphabet_encode_char, s_alphabet_decode_char
+};
+
+
+/* Append a fixed string to the text output, if requested */
+static int s_encoder_text(morse_encoder_td *enc, const char *str)
+{
+    if (!(enc->out->requested & MORSE_OUTPUT_TEXT)) {
+        return 0;
+    }
+
+    return s_buffer_append(&enc->text, str, strlen(str));
+}
+
+
+/* Hold the key in the same state for some units */
+static int s_encoder_units(morse_encoder_td *enc, bool key_down,
+        unsigned units)
+{
+    morse_output_td *out = enc->out;
+
+    if (out->requested & MORSE_OUTPUT_TIMELINE) {
+        if (out->timeline_len >= out->timeline_size) {
             return -1;
         }
+        out->timeline[out->timeline_len++] = (uint8_t) units;
+    }
 
-        if (bitree_is_eob(node)) {
+    if (out->requested & MORSE_OUTPUT_BITS) {
+        if (out->bits_len + units > out->bits_size * CHAR_BIT) {
             return -1;
         }
+        for (unsigned i = 0; i < units; ++i, ++out->bits_len) {
+            uint8_t mask = (uint8_t) (0x80u >> (out->bits_len % CHAR_BIT));
+
+            if (key_down) {
+                out->bits[out->bits_len / CHAR_BIT] |= mask;
+            } else {
+                out->bits[out->bits_len / CHAR_BIT] &= (uint8_t) ~mask;
+            }
+        }
     }
 
-    if (bistree_is_hidden(node)) {
+    out->duration += units;
+
+    return 0;
+}
+
+
+/* Send a 'dit' or a 'dah', after the gap that precedes it */
+static int s_encoder_element(morse_encoder_td *enc, bool is_dah)
+{
+    if ((enc->out->requested & MORSE_OUTPUT_TEXT) &&
+            s_buffer_element(&enc->text, is_dah, enc->use_separators) != 0) {
         return -1;
     }
 
-    *dst = *(char *) bistree_data(node);
+    if (enc->out->requested &
+            (MORSE_OUTPUT_TIMELINE | MORSE_OUTPUT_BITS |
+             MORSE_OUTPUT_DURATION)) {
+        if (enc->keyed && s_encoder_units(enc, false, enc->gap) != 0) {
+            return -1;
+        }
+        if (s_encoder_units(enc, true,
+                    is_dah ? MORSE_UNITS_DAH : MORSE_UNITS_DIT) != 0) {
+            return -1;
+        }
+    }
+
+    enc->keyed = true;
+    enc->gap = MORSE_UNITS_ELEMENT_GAP;
+
     return 0;
 }
 
 
-/* Initialize a new Morse tree */
-morse_tree_td *morse_init(void)
+/* Send every element of a code word */
+static int s_encoder_code(morse_encoder_td *enc, unsigned code)
 {
-    morse_tree_td *morse;
+    /* Elements are the bits below the leading 1, first one highest */
+    for (unsigned i = morse_alphabet_length(code); i > 0; --i) {
+        if (s_encoder_element(enc, (code >> (i - 1)) & 1) != 0) {
+            return -1;
+        }
+    }
 
-    morse = bistree_init(s_compare, free);
-    if (morse == NULL) {
-        return NULL;
+    return 0;
+}
+
+
+/* Lengthen the gap before the next element */
+static void s_encoder_gap(morse_encoder_td *enc, unsigned units)
+{
+    if (units > enc->gap) {
+        enc->gap = units;
     }
+}
 
-    s_morse_generate_nodes(morse);
 
-    return morse;
+/* Encode every character of a prosign, sent without character gaps */
+static int s_morse_encode_prosign(const morse_codec_td *ops,
+        const void *codec, const char *prosign, morse_encoder_td *enc)
+{
+    unsigned code;
+
+    for (size_t i = 0; prosign[i] != '\0'; ++i) {
+        if (ops->encode_char(codec, prosign[i], &code) != 0 ||
+                s_encoder_code(enc, code) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
 }
 
 
-/* Encode a entire string until the 'NULL' character is found */
-int morse_encode(const morse_tree_td *morse,
-        char *dst, const char *src, uint8_t flags)
+/* Start the decoding of a message into the given buffer */
+static void s_decoder_init(morse_decoder_td *dec, const morse_codec_td *ops,
+        const void *codec, char *dst, size_t dst_size)
+{
+    dec->ops = ops;
+    dec->codec = codec;
+    dec->out.data = dst;
+    dec->out.size = dst_size;
+    dec->out.len = 0;
+    dec->code = 1;
+    dec->has_token = false;
+    dec->truncated = false;
+    dst[0] = '\0';
+}
+
+
+/* Decode a code word and append its character to the output */
+static void s_decoder_put_code(morse_decoder_td *dec, unsigned code)
+{
+    char decoded;
+
+    if (dec->ops->decode_char(dec->codec, code, &decoded) == 0 &&
+            s_buffer_put(&dec->out, decoded) != 0) {
+        dec->truncated = true;
+    }
+}
+
+
+/* Finish the pending token, if any, and decode it */
+static void s_decoder_flush_token(morse_decoder_td *dec)
 {
-    char *data;
-    char *tmp;
-    size_t src_len;
+    if (!dec->has_token) {
+        return;
+    }
+
+    s_decoder_put_code(dec, dec->code);
+    dec->code = 1;
+    dec->has_token = false;
+}
 
-    if (morse == NULL || dst == NULL || src == NULL) {
+
+/* Encode a buffer of known length with the given codec, in one pass */
+static int s_morse_encode(const morse_codec_td *ops, const void *codec,
+        morse_output_td *out, const char *src, size_t src_len,
+        uint8_t flags)
+{
+    morse_encoder_td enc;
+
+    if (codec == NULL || out == NULL || src == NULL) {
         return -1;
     }
 
-    tmp = malloc(sizeof(char));
-    if (tmp == NULL) {
+    if (((out->requested & MORSE_OUTPUT_TEXT) &&
+                (out->text == NULL || out->text_size == 0)) ||
+            ((out->requested & MORSE_OUTPUT_TIMELINE) &&
+                out->timeline == NULL) ||
+            ((out->requested & MORSE_OUTPUT_BITS) && out->bits == NULL)) {
         return -1;
     }
 
-    src_len = strlen(src);
-    dst[0] = '\0';
+    enc.out = out;
+    enc.text.data = out->text;
+    enc.text.size = out->text_size;
+    enc.text.len = 0;
+    enc.use_separators = (flags & MORSE_USE_SEPARATORS) > 0;
+    enc.keyed = false;
+    enc.gap = 0;
+
+    out->text_len = 0;
+    out->timeline_len = 0;
+    out->bits_len = 0;
+    out->duration = 0;
+    if (out->requested & MORSE_OUTPUT_TEXT) {
+        out->text[0] = '\0';
+    }
 
     /* Start the transmission: add prosign <CT> */
     if (flags & MORSE_USE_PROSIGNS) {
-        for (size_t i = 0; i < strlen(MORSE_PROSIGN_CT); ++i) {
-            *tmp = MORSE_PROSIGN_CT[i];
-            data = tmp;
-            if (s_morse_encode_char(morse, bitree_root(morse), data, dst,
-                    (flags & MORSE_USE_SEPARATORS) > 0) != 0) {
-                return -1;
-            }
+        if (s_morse_encode_prosign(ops, codec, MORSE_PROSIGN_CT,
+                    &enc) != 0) {
+            return -1;
         }
 
-        if (flags & MORSE_USE_SEPARATORS) {
-            strcat(dst, MORSE_WORD_SEPARATOR);
+        if (enc.use_separators &&
+                s_encoder_text(&enc, MORSE_WORD_SEPARATOR) != 0) {
+            return -1;
         }
+        s_encoder_gap(&enc, MORSE_UNITS_WORD_GAP);
     }
 
     /* Send the transmission */
     for (size_t i = 0; i < src_len; ++i) {
-        /* Ignore filler characters */
-        if (src[i] == '~' ||
-                src[i] == '(' || src[i] == ')' ||
-                src[i] == '[' || src[i] == ']') {
-            continue;
-        }
+        unsigned code;
+        int retval;
 
         /* Use the word separator if needed */
-        if (flags & MORSE_USE_SEPARATORS) {
-            if (src[i] == ' ') {
-                strcat(dst, MORSE_WORD_SEPARATOR);
-                continue;
+        if (src[i] == ' ') {
+            if (enc.use_separators &&
+                    s_encoder_text(&enc, MORSE_WORD_SEPARATOR) != 0) {
+                return -1;
             }
+            s_encoder_gap(&enc, MORSE_UNITS_WORD_GAP);
+            continue;
         }
 
         /* Encode only if it's a valid character */
-        if (strchr(MORSE_WEIGHTED_NODES, toupper(src[i])) != NULL) {
-            /* Start encoding the string */
-            *tmp = src[i];
-            data = tmp;
+        retval = ops->encode_char(codec, src[i], &code);
+        if (retval < 0 || (retval == 0 && s_encoder_code(&enc, code) != 0)) {
+            return -1;
+        } else if (retval > 0) {
+            continue;
+        }
 
-            if (s_morse_encode_char(morse, bitree_root(morse), data, dst,
-                    (flags & MORSE_USE_SEPARATORS) > 0) != 0) {
+        s_encoder_gap(&enc, MORSE_UNITS_CHAR_GAP);
+        if (enc.use_separators && i + 1 < src_len &&
+                src[i + 1] != ' ' && src[i + 1] != '\0') {
+            if (s_encoder_text(&enc, MORSE_CHAR_SEPARATOR) != 0) {
                 return -1;
             }
-            if ((flags & MORSE_USE_SEPARATORS) &&
-                    src[i + 1] != ' ' && src[i + 1] != '\0') {
-                strcat(dst, MORSE_CHAR_SEPARATOR);
-            }
         }
     }
 
     /* End the transmission: add prosign <SK> */
     if (flags & MORSE_USE_PROSIGNS) {
-        if (flags & MORSE_USE_SEPARATORS) {
-            strcat(dst, MORSE_WORD_SEPARATOR);
+        if (enc.use_separators &&
+                s_encoder_text(&enc, MORSE_WORD_SEPARATOR) != 0) {
+            return -1;
         }
+        s_encoder_gap(&enc, MORSE_UNITS_WORD_GAP);
 
-        for (size_t i = 0; i < strlen(MORSE_PROSIGN_SK); ++i) {
-            *tmp = MORSE_PROSIGN_SK[i];
-            data = tmp;
-            if (s_morse_encode_char(morse, bitree_root(morse), data, dst,
-                    (flags & MORSE_USE_SEPARATORS) > 0) != 0){
-                return -1;
-            }
+        if (s_morse_encode_prosign(ops, codec, MORSE_PROSIGN_SK,
+                    &enc) != 0) {
+            return -1;
         }
     }
 
-    free(tmp);
+    out->text_len = enc.text.len;
+
     return 0;
 }
 
 
-/* Decode a full Morse message */
-int morse_decode(const morse_tree_td *morse,
-        char *dst, const char *src, uint8_t flags)
+/* Encode a buffer into text only, as the public text encoders do */
+static int s_morse_encode_text(const morse_codec_td *ops, const void *codec,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
 {
-    char token[MORSE_MESSAGE_MAX_LENGTH + 1];
-    size_t tok_pos = 0;
-    size_t out_pos = 0;
-    size_t src_len;
+    morse_output_td out;
+
+    memset(&out, 0, sizeof(out));
+    out.requested = MORSE_OUTPUT_TEXT;
+    out.text = dst;
+    out.text_size = dst_size;
+
+    if (dst == NULL || dst_size == 0 ||
+            s_morse_encode(ops, codec, &out, src, src_len, flags) != 0) {
+        return -1;
+    }
+
+    if (dst_len != NULL) {
+        *dst_len = out.text_len;
+    }
+
+    return 0;
+}
+
+
+/* Decode a buffer of known length with the given codec; 1 if truncated */
+static int s_morse_decode(const morse_codec_td *ops, const void *codec,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    size_t word_sep_len = strlen(MORSE_WORD_SEPARATOR);
+    size_t char_sep_len = strlen(MORSE_CHAR_SEPARATOR);
     size_t i = 0;
+    morse_decoder_td dec;
 
-    if (morse == NULL || dst == NULL || src == NULL) {
+    if (codec == NULL || dst == NULL || src == NULL || dst_size == 0) {
         return -1;
     }
 
-    src_len = strlen(src);
-    dst[0] = '\0';
+    s_decoder_init(&dec, ops, codec, dst, dst_size);
 
-    while (i < src_len && out_pos < MORSE_MESSAGE_MAX_LENGTH) {
+    while (i < src_len && dec.out.len + 1 < dec.out.size) {
         size_t run;
 
+        /* Elements are the most common characters: no separator begins
+         * with them, so they need no further checks */
+        if (src[i] == MORSE_DIT[0] || src[i] == MORSE_DAH[0]) {
+            dec.code = morse_util_code_push(dec.code, src[i] == MORSE_DAH[0]);
+            dec.has_token = true;
+            ++i;
+            continue;
+        }
+
         /* If separators mode is enabled, check for word separator first */
         if ((flags & MORSE_USE_SEPARATORS) &&
-                i + strlen(MORSE_WORD_SEPARATOR) <= src_len &&
-                strncmp(&src[i], MORSE_WORD_SEPARATOR,
-                    strlen(MORSE_WORD_SEPARATOR)) == 0) {
-            /* finalize current token */
-            if (tok_pos > 0) {
-                char decoded;
-                token[tok_pos] = '\0';
-                if (s_morse_decode_char(morse, token, &decoded) == 0) {
-                    dst[out_pos++] = decoded;
-                }
-                tok_pos = 0;
-            }
+                i + word_sep_len <= src_len &&
+                memcmp(&src[i], MORSE_WORD_SEPARATOR, word_sep_len) == 0) {
+            /* finalize current token and word */
+            s_decoder_flush_token(&dec);
             /* append space as word separator */
-            dst[out_pos++] = ' ';
-            i += strlen(MORSE_WORD_SEPARATOR);
+            (void) s_buffer_put(&dec.out, ' ');
+            i += word_sep_len;
             continue;
         }
 
         /* If separators mode is enabled, check for character separator */
         if ((flags & MORSE_USE_SEPARATORS) &&
-                i + strlen(MORSE_CHAR_SEPARATOR) <= src_len &&
-                strncmp(&src[i], MORSE_CHAR_SEPARATOR,
-                    strlen(MORSE_CHAR_SEPARATOR)) == 0) {
-            if (tok_pos > 0) {
-                char decoded;
-                token[tok_pos] = '\0';
-                if (s_morse_decode_char(morse, token, &decoded) == 0) {
-                    dst[out_pos++] = decoded;
-                }
-                tok_pos = 0;
-            }
-            i += strlen(MORSE_CHAR_SEPARATOR);
+                i + char_sep_len <= src_len &&
+                memcmp(&src[i], MORSE_CHAR_SEPARATOR, char_sep_len) == 0) {
+            s_decoder_flush_token(&dec);
+            i += char_sep_len;
             continue;
         }
 
         /* Non-separators mode: single space separates characters; two
          * or more spaces separate words */
         if (!(flags & MORSE_USE_SEPARATORS) && src[i] == ' ') {
-            if (tok_pos > 0) {
-                char decoded;
-                token[tok_pos] = '\0';
-                if (s_morse_decode_char(morse, token, &decoded) == 0) {
-                    dst[out_pos++] = decoded;
-                }
-                tok_pos = 0;
-            }
+            s_decoder_flush_token(&dec);
             /* Count consecutive spaces to detect word boundary */
             run = 1;
             while (i + run < src_len && src[i + run] == ' ') {
@@ -418,38 +741,463 @@ int morse_decode(const morse_tree_td *morse,
             }
             if (run >= 2) {
                 /* treat as word separator */
-                dst[out_pos++] = ' ';
+                s_decoder_flush_token(&dec);
+                (void) s_buffer_put(&dec.out, ' ');
             }
             i += run;
             continue;
         }
 
-        /* Accept only 'MORSE_DIT', 'MORSE_DAH' or single-space
-         * separators inside token */
-        if (src[i] == MORSE_DIT[0] || src[i] == MORSE_DAH[0] ||
-                src[i] == MORSE_SEP[0]) {
-            if (tok_pos < sizeof(token) - 1) {
-                token[tok_pos++] = src[i];
+        /* Ignore any other characters, such as single-space separators
+         * inside the token */
+        ++i;
+    }
+
+    /* Elements left over once the output is full are lost */
+    for (; i < src_len && !dec.truncated; ++i) {
+        if (src[i] == MORSE_DIT[0] || src[i] == MORSE_DAH[0]) {
+            dec.truncated = true;
+        }
+    }
+
+    /* Process the final token, if any */
+    s_decoder_flush_token(&dec);
+
+    s_trim(dst);
+
+    if (dst_len != NULL) {
+        *dst_len = strlen(dst);
+    }
+
+    return dec.truncated ? 1 : 0;
+}
+
+
+/* Find the end of the word starting at @p i, and the length of the word
+ * separator after it, 0 if none (the end of the buffer) */
+static size_t s_word_end(const char *src, size_t src_len, size_t i,
+        uint8_t flags, size_t *sep_len)
+{
+    /* Word separators are made of spaces only (at least two without
+     * separators), and the decoder checks them first at every position,
+     * so a word ends at the first window of that many spaces */
+    size_t word_sep_len = (flags & MORSE_USE_SEPARATORS) ?
+        strlen(MORSE_WORD_SEPARATOR) : 2;
+
+    while (i + word_sep_len <= src_len) {
+        size_t k = word_sep_len;
+
+        /* No window with a character other than a space matches, so
+         * skip past the last one in this window */
+        while (k > 0 && src[i + k - 1] == ' ') {
+            --k;
+        }
+        if (k == 0) {
+            /* Without separators, the whole run is a single one */
+            *sep_len = word_sep_len;
+            while (!(flags & MORSE_USE_SEPARATORS) &&
+                    i + *sep_len < src_len && src[i + *sep_len] == ' ') {
+                ++(*sep_len);
+            }
+            return i;
+        }
+        i += k;
+    }
+
+    *sep_len = 0;
+    return src_len;
+}
+
+
+/* Decode a word through a cache into @p dst, where @p room characters are
+ * left before the output of @e s_morse_decode would be full; 1 if the word
+ * doesn't fit in them */
+static int s_morse_decode_word(const morse_codec_td *ops, const void *codec,
+        morse_cache_td *cache, char *dst, size_t room, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    char word[MORSE_CACHE_WORD_MAX + 1];
+    const char *cached = NULL;
+
+    /* A hit copies the word without looking at its elements */
+    if (src_len <= MORSE_CACHE_KEY_MAX) {
+        cached = morse_cache_lookup(cache, src, src_len, flags, dst_len);
+        if (cached == NULL && s_morse_decode(ops, codec, word, sizeof(word),
+                    dst_len, src, src_len, flags) == 0) {
+            (void) morse_cache_insert(cache, src, src_len, flags, word,
+                    *dst_len);
+            cached = word;
+        }
+    }
+
+    if (cached != NULL) {
+        if (*dst_len >= room) {
+            return 1;
+        }
+        memcpy(dst, cached, *dst_len);
+        return 0;
+    }
+
+    /* Words too long for the cache are decoded in place */
+    return (s_morse_decode(ops, codec, dst, room, dst_len, src, src_len,
+                flags) == 0) ? 0 : 1;
+}
+
+
+/* Decode a buffer of known length word by word through a cache; 1 if
+ * truncated */
+static int s_morse_decode_cached(const morse_codec_td *ops,
+        const void *codec, morse_cache_td *cache, char *dst,
+        size_t dst_size, size_t *dst_len, const char *src, size_t src_len,
+        uint8_t flags)
+{
+    size_t len = 0;
+    size_t lead = 0;
+    size_t spaces = 0;
+    size_t i = 0;
+
+    if (codec == NULL || cache == NULL || dst == NULL || src == NULL ||
+            dst_size == 0) {
+        return -1;
+    }
+
+    /* A space per word separator, but none before the first word or
+     * after the last one, as the whole message is trimmed.  Those before
+     * the first word still take room in the output of @e s_morse_decode,
+     * which is redone from the start if it could fill up, so that
+     * truncated messages are decoded the same way */
+    while (i < src_len) {
+        size_t sep_len;
+        size_t end = s_word_end(src, src_len, i, flags, &sep_len);
+        size_t at = (len > 0) ? len + spaces : 0;
+        size_t word_len = 0;
+
+        if (lead + len + spaces + 1 >= dst_size) {
+            return s_morse_decode(ops, codec, dst, dst_size, dst_len,
+                    src, src_len, flags);
+        }
+
+        if (end > i) {
+            if (s_morse_decode_word(ops, codec, cache, &dst[at],
+                        dst_size - (lead + len + spaces + 1), &word_len,
+                        &src[i], end - i, flags) != 0) {
+                return s_morse_decode(ops, codec, dst, dst_size, dst_len,
+                        src, src_len, flags);
+            }
+        }
+        if (word_len > 0) {
+            if (len > 0) {
+                memset(&dst[len], ' ', spaces);
             } else {
-                /* token too long: drop it (robustness) */
-                tok_pos = 0;
+                lead = spaces;
             }
+            len = at + word_len;
+            spaces = 0;
         }
-        /* Ignore any other characters */
-        ++i;
+        if (sep_len > 0) {
+            ++spaces;
+        }
+        i = end + sep_len;
+    }
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+
+    return 0;
+}
+
+
+/* Decode a keying timeline with the given codec; 1 if truncated */
+static int s_morse_decode_timeline(const morse_codec_td *ops,
+        const void *codec, char *dst, size_t dst_size, size_t *dst_len,
+        const uint8_t *timeline, size_t timeline_len)
+{
+    morse_decoder_td dec;
+    size_t i;
+
+    if (codec == NULL || dst == NULL || timeline == NULL || dst_size == 0) {
+        return -1;
     }
 
-    /* Process final token if any */
-    if (tok_pos > 0 && out_pos < MORSE_MESSAGE_MAX_LENGTH) {
-        char decoded;
-        token[tok_pos] = '\0';
-        if (s_morse_decode_char(morse, token, &decoded) == 0) {
-            dst[out_pos++] = decoded;
+    s_decoder_init(&dec, ops, codec, dst, dst_size);
+
+    for (i = 0; i < timeline_len && dec.out.len + 1 < dec.out.size; ++i) {
+        if (i % 2 == 0) {
+            /* Key-down: a 'dit' or a 'dah' */
+            dec.code = morse_util_code_push(dec.code,
+                    timeline[i] >= MORSE_UNITS_DAH_MIN);
+            dec.has_token = true;
+        } else if (timeline[i] >= MORSE_UNITS_WORD_GAP_MIN) {
+            /* Key-up between words */
+            s_decoder_flush_token(&dec);
+            (void) s_buffer_put(&dec.out, ' ');
+        } else if (timeline[i] >= MORSE_UNITS_CHAR_GAP_MIN) {
+            /* Key-up between characters */
+            s_decoder_flush_token(&dec);
         }
     }
 
-    dst[out_pos] = '\0';
+    /* Key-downs left over once the output is full are lost */
+    if (i + 1 < timeline_len || (i < timeline_len && i % 2 == 0)) {
+        dec.truncated = true;
+    }
+
+    /* Process final character and word if any */
+    s_decoder_flush_token(&dec);
+
     s_trim(dst);
 
+    if (dst_len != NULL) {
+        *dst_len = strlen(dst);
+    }
+
+    return dec.truncated ? 1 : 0;
+}
+
+
+/* Assign to an alphabet the characters of a subtree of a Morse tree */
+static int s_morse_alphabet_fill(morse_alphabet_td *alphabet,
+        const bitree_node_td *node, unsigned code)
+{
+    char c;
+
+    if (bitree_is_eob(node) || code >= MORSE_ALPHABET_CODES) {
+        return 0;
+    }
+
+    c = *(const char *) bistree_data(node);
+    if (!bistree_is_hidden(node) && c != '~' &&
+            c != '(' && c != ')' && c != '[' && c != ']') {
+        if (morse_alphabet_assign(alphabet, c, code) != 0) {
+            return -1;
+        }
+    }
+
+    if (s_morse_alphabet_fill(alphabet, bitree_left(node), code << 1) != 0) {
+        return -1;
+    }
+
+    return s_morse_alphabet_fill(alphabet, bitree_right(node),
+            (code << 1) | 1);
+}
+
+
+/* Initialize a new Morse tree */
+morse_tree_td *morse_init(void)
+{
+    morse_tree_td *morse;
+
+    /* A table out of step with the nodes would build a wrong tree */
+    if (!s_rank_check()) {
+        return NULL;
+    }
+
+    morse = bistree_init(s_compare, free);
+    if (morse == NULL) {
+        return NULL;
+    }
+
+    s_morse_generate_nodes(morse);
+
+    return morse;
+}
+
+
+/* Encode a entire string until the 'NULL' character is found */
+int morse_encode(const morse_tree_td *morse,
+        char *dst, const char *src, uint8_t flags)
+{
+    if (src == NULL) {
+        return -1;
+    }
+
+    return morse_encode_buf(morse, dst, SIZE_MAX, NULL,
+            src, strlen(src), flags);
+}
+
+
+/* Encode a buffer of known length into a bounded output buffer */
+int morse_encode_buf(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return s_morse_encode_text(&s_tree_codec, morse, dst, dst_size, dst_len,
+            src, src_len, flags);
+}
+
+
+/* Encode a buffer into every requested output in a single pass */
+int morse_encode_multi(const morse_tree_td *morse, morse_output_td *out,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return s_morse_encode(&s_tree_codec, morse, out, src, src_len, flags);
+}
+
+
+/* Decode a full Morse message */
+int morse_decode(const morse_tree_td *morse,
+        char *dst, const char *src, uint8_t flags)
+{
+    if (src == NULL) {
+        return -1;
+    }
+
+    /* Longer messages are cut silently at the maximum length */
+    if (s_morse_decode(&s_tree_codec, morse, dst,
+                MORSE_MESSAGE_MAX_LENGTH + 1, NULL, src, strlen(src),
+                flags) < 0) {
+        return -1;
+    }
+
     return 0;
 }
+
+
+/* Decode a buffer of known length into a bounded output buffer */
+int morse_decode_buf(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return (s_morse_decode(&s_tree_codec, morse, dst, dst_size,
+                dst_len, src, src_len, flags) != 0) ? -1 : 0;
+}
+
+
+/* Decode a keying timeline into plain text */
+int morse_decode_timeline(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const uint8_t *timeline, size_t timeline_len)
+{
+    return (s_morse_decode_timeline(&s_tree_codec, morse, dst, dst_size,
+                dst_len, timeline, timeline_len) != 0) ? -1 : 0;
+}
+
+
+/* Decode a buffer of known length, decoding repeated words at once */
+int morse_decode_cached(const morse_tree_td *morse, morse_cache_td *cache,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return (s_morse_decode_cached(&s_tree_codec, morse, cache, dst,
+                dst_size, dst_len, src, src_len, flags) != 0) ? -1 : 0;
+}
+
+
+/* Encode several buffers back to back into a single output buffer */
+int morse_encode_batch(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *offsets,
+        const char *const *src, const size_t *src_len, size_t count,
+        uint8_t flags)
+{
+    size_t pos = 0;
+    size_t len;
+
+    if (dst == NULL || offsets == NULL || src == NULL || src_len == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (pos >= dst_size ||
+                morse_encode_buf(morse, &dst[pos], dst_size - pos, &len,
+                    src[i], src_len[i], flags) != 0) {
+            return -1;
+        }
+        offsets[i] = pos;
+        pos += len + 1;
+    }
+
+    return 0;
+}
+
+
+/* Decode several buffers back to back into a single output buffer */
+int morse_decode_batch(const morse_tree_td *morse,
+        char *dst, size_t dst_size, size_t *offsets,
+        const char *const *src, const size_t *src_len, size_t count,
+        uint8_t flags)
+{
+    size_t pos = 0;
+    size_t len;
+
+    if (dst == NULL || offsets == NULL || src == NULL || src_len == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (pos >= dst_size ||
+                morse_decode_buf(morse, &dst[pos], dst_size - pos, &len,
+                    src[i], src_len[i], flags) != 0) {
+            return -1;
+        }
+        offsets[i] = pos;
+        pos += len + 1;
+    }
+
+    return 0;
+}
+
+
+/* Build the table-driven alphabet of a Morse tree */
+int morse_alphabet_from_tree(morse_alphabet_td *alphabet,
+        const morse_tree_td *morse)
+{
+    if (alphabet == NULL || morse == NULL) {
+        return -1;
+    }
+
+    morse_alphabet_clear(alphabet);
+
+    return s_morse_alphabet_fill(alphabet, bitree_root(morse), 1);
+}
+
+
+/* Encode a buffer of known length using the tables of an alphabet */
+int morse_alphabet_encode(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return s_morse_encode_text(&s_alphabet_codec, alphabet, dst, dst_size,
+            dst_len, src, src_len, flags);
+}
+
+
+/* Encode into every requested output using the tables of an alphabet */
+int morse_alphabet_encode_multi(const morse_alphabet_td *alphabet,
+        morse_output_td *out, const char *src, size_t src_len,
+        uint8_t flags)
+{
+    return s_morse_encode(&s_alphabet_codec, alphabet, out,
+            src, src_len, flags);
+}
+
+
+/* Decode a buffer of known length using the tables of an alphabet */
+int morse_alphabet_decode(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return (s_morse_decode(&s_alphabet_codec, alphabet, dst,
+                dst_size, dst_len, src, src_len, flags) != 0) ? -1 : 0;
+}
+
+
+/* Decode a buffer of known length using an alphabet and a cache */
+int morse_alphabet_decode_cached(const morse_alphabet_td *alphabet,
+        morse_cache_td *cache, char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, uint8_t flags)
+{
+    return (s_morse_decode_cached(&s_alphabet_codec, alphabet, cache, dst,
+                dst_size, dst_len, src, src_len, flags) != 0) ? -1 : 0;
+}
+
+
+/* Decode a keying timeline using the tables of an alphabet */
+int morse_alphabet_decode_timeline(const morse_alphabet_td *alphabet,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const uint8_t *timeline, size_t timeline_len)
+{
+    return (s_morse_decode_timeline(&s_alphabet_codec, alphabet, dst,
+                dst_size, dst_len, timeline, timeline_len) != 0) ? -1 : 0;
+}
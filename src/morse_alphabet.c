@@ -0,0 +1,323 @@
+/**
+ * @file morse_alphabet.c
+ *
+ * @brief Table-driven Morse alphabets and custom code assignment
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <ctype.h>  /* isgraph, isspace, toupper */
+#include <stdio.h>  /* FILE, fgets, fprintf */
+#include <stdlib.h> /* qsort */
+#include <string.h> /* memset, strlen */
+
+/* Local includes */
+#include <morse.h>
+#include <morse_alphabet.h>
+
+
+/* Maximum length of a line in an alphabet definition */
+#define MORSE_ALPHABET_LINE_MAX (64)
+
+
+/**
+ * @brief Symbol and its number of occurrences, to be ranked
+ */
+typedef struct {
+    unsigned long count;    /**< Occurrences in the traffic */
+    char symbol;            /**< ASCII character */
+} morse_symbol_count_td;
+
+
+/* Normalize a character to the form used as table key; '#' is not a
+ * symbol, since it starts the comments of a definition */
+static int s_symbol_key(char c)
+{
+    int key = toupper((unsigned char) c);
+
+    if (key < 0 || key >= MORSE_ALPHABET_SYMBOLS || !isgraph(key) ||
+            key == '#') {
+        return -1;
+    }
+
+    return key;
+}
+
+
+/* Order code words by increasing airtime, then by heap index */
+static int s_compare_codes(const void *key1, const void *key2)
+{
+    unsigned code1 = *(const unsigned *) key1;
+    unsigned code2 = *(const unsigned *) key2;
+    unsigned cost1 = morse_alphabet_cost(code1);
+    unsigned cost2 = morse_alphabet_cost(code2);
+
+    if (cost1 != cost2) {
+        return (cost1 > cost2) ? 1 : -1;
+    }
+
+    return (code1 > code2) - (code1 < code2);
+}
+
+
+/* Order symbols by decreasing count, then by character */
+static int s_compare_counts(const void *key1, const void *key2)
+{
+    const morse_symbol_count_td *sym1 = key1;
+    const morse_symbol_count_td *sym2 = key2;
+
+    if (sym1->count != sym2->count) {
+        return (sym1->count < sym2->count) ? 1 : -1;
+    }
+
+    return (sym1->symbol > sym2->symbol) - (sym1->symbol < sym2->symbol);
+}
+
+
+/* Empty an alphabet */
+void morse_alphabet_clear(morse_alphabet_td *alphabet)
+{
+    if (alphabet == NULL) {
+        return;
+    }
+
+    memset(alphabet->code, MORSE_ALPHABET_NO_CODE, sizeof(alphabet->code));
+    memset(alphabet->symbol, '\0', sizeof(alphabet->symbol));
+}
+
+
+/* Assign a code word to a symbol */
+int morse_alphabet_assign(morse_alphabet_td *alphabet, char symbol,
+        unsigned code)
+{
+    int key = s_symbol_key(symbol);
+
+    if (alphabet == NULL || key < 0 ||
+            code <= 1 || code >= MORSE_ALPHABET_CODES) {
+        return -1;
+    }
+
+    if (alphabet->code[key] != MORSE_ALPHABET_NO_CODE ||
+            alphabet->symbol[code] != '\0') {
+        return -1;
+    }
+
+    alphabet->code[key] = (uint8_t) code;
+    alphabet->symbol[code] = (char) key;
+
+    return 0;
+}
+
+
+/* Number of elements of a code word */
+unsigned morse_alphabet_length(unsigned code)
+{
+    unsigned length = 0;
+
+    if (code == MORSE_ALPHABET_NO_CODE) {
+        return 0;
+    }
+
+    while (code > 1) {
+        code >>= 1;
+        ++length;
+    }
+
+    return length;
+}
+
+
+/* Airtime of a code word, including the gap that follows it */
+unsigned morse_alphabet_cost(unsigned code)
+{
+    unsigned cost = MORSE_UNITS_CHAR_GAP;
+
+    if (code <= 1) {
+        return 0;
+    }
+
+    for (; code > 1; code >>= 1) {
+        cost += (code & 1) ? MORSE_UNITS_DAH : MORSE_UNITS_DIT;
+        if (code > 3) {
+            /* Not the first element: there's a gap before it */
+            cost += MORSE_UNITS_ELEMENT_GAP;
+        }
+    }
+
+    return cost;
+}
+
+
+/* Build the code of minimum expected airtime for a distribution */
+int morse_alphabet_optimal(morse_alphabet_td *alphabet,
+        const unsigned long counts[MORSE_ALPHABET_SYMBOLS])
+{
+    morse_symbol_count_td symbols[MORSE_ALPHABET_SYMBOLS];
+    unsigned codes[MORSE_ALPHABET_CODES - 2];
+    size_t n_symbols = 0;
+    size_t n_codes = 0;
+
+    if (alphabet == NULL || counts == NULL) {
+        return -1;
+    }
+
+    /* Gather the symbols in use, merging lowercase into uppercase */
+    memset(symbols, 0, sizeof(symbols));
+    for (int c = 0; c < MORSE_ALPHABET_SYMBOLS; ++c) {
+        int key = s_symbol_key((char) c);
+
+        if (key >= 0) {
+            symbols[key].symbol = (char) key;
+            symbols[key].count += counts[c];
+        }
+    }
+    for (int c = 0; c < MORSE_ALPHABET_SYMBOLS; ++c) {
+        if (symbols[c].count > 0) {
+            symbols[n_symbols++] = symbols[c];
+        }
+    }
+
+    /* Every non-empty code word, from the cheapest */
+    for (unsigned code = 2; code < MORSE_ALPHABET_CODES; ++code) {
+        codes[n_codes++] = code;
+    }
+
+    if (n_symbols > n_codes) {
+        return -1;
+    }
+
+    qsort(symbols, n_symbols, sizeof(symbols[0]), s_compare_counts);
+    qsort(codes, n_codes, sizeof(codes[0]), s_compare_codes);
+
+    /* Pair the most frequent symbols with the cheapest code words */
+    morse_alphabet_clear(alphabet);
+    for (size_t i = 0; i < n_symbols; ++i) {
+        if (morse_alphabet_assign(alphabet, symbols[i].symbol,
+                    codes[i]) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Total airtime of some traffic using an alphabet */
+int morse_alphabet_airtime(const morse_alphabet_td *alphabet,
+        const unsigned long counts[MORSE_ALPHABET_SYMBOLS], uint64_t *units)
+{
+    uint64_t total = 0;
+
+    if (alphabet == NULL || counts == NULL || units == NULL) {
+        return -1;
+    }
+
+    for (int c = 0; c < MORSE_ALPHABET_SYMBOLS; ++c) {
+        int key;
+
+        if (counts[c] == 0 || c == ' ') {
+            continue;
+        }
+
+        key = s_symbol_key((char) c);
+        if (key < 0 || alphabet->code[key] == MORSE_ALPHABET_NO_CODE) {
+            return -1;
+        }
+
+        total += (uint64_t) counts[c] *
+            morse_alphabet_cost(alphabet->code[key]);
+    }
+
+    *units = total;
+    return 0;
+}
+
+
+/* Write an alphabet as text */
+int morse_alphabet_save(const morse_alphabet_td *alphabet, FILE *stream)
+{
+    if (alphabet == NULL || stream == NULL) {
+        return -1;
+    }
+
+    for (int c = 0; c < MORSE_ALPHABET_SYMBOLS; ++c) {
+        char elements[MORSE_ALPHABET_MAX_ELEMENTS + 1];
+        unsigned code = alphabet->code[c];
+        unsigned length = morse_alphabet_length(code);
+
+        if (code == MORSE_ALPHABET_NO_CODE) {
+            continue;
+        }
+
+        /* The first element is the most significant bit below the
+         * leading 1 */
+        for (unsigned i = length; i > 0; --i, code >>= 1) {
+            elements[i - 1] = (code & 1) ? MORSE_DAH[0] : MORSE_DIT[0];
+        }
+        elements[length] = '\0';
+
+        if (fprintf(stream, "%c %s\n", c, elements) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Read an alphabet written by 'morse_alphabet_save' */
+int morse_alphabet_load(morse_alphabet_td *alphabet, FILE *stream)
+{
+    char line[MORSE_ALPHABET_LINE_MAX];
+
+    if (alphabet == NULL || stream == NULL) {
+        return -1;
+    }
+
+    morse_alphabet_clear(alphabet);
+
+    while (fgets(line, sizeof(line), stream) != NULL) {
+        unsigned code = 1;
+        size_t len = strlen(line);
+        size_t i;
+
+        /* Reject lines that did not fit in the buffer */
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            return -1;
+        }
+
+        if (line[0] == '#' || isspace((unsigned char) line[0])) {
+            continue;
+        }
+
+        if (line[1] != ' ') {
+            return -1;
+        }
+
+        for (i = 2; line[i] == MORSE_DIT[0] || line[i] == MORSE_DAH[0];
+                ++i) {
+            code = (code << 1) | (line[i] == MORSE_DAH[0]);
+            if (code >= MORSE_ALPHABET_CODES) {
+                return -1;
+            }
+        }
+
+        /* Only trailing whitespace is allowed after the code word */
+        for (; line[i] != '\0'; ++i) {
+            if (!isspace((unsigned char) line[i])) {
+                return -1;
+            }
+        }
+
+        if (morse_alphabet_assign(alphabet, line[0], code) != 0) {
+            return -1;
+        }
+    }
+
+    return ferror(stream) ? -1 : 0;
+}
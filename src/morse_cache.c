@@ -0,0 +1,132 @@
+/**
+ * @file morse_cache.c
+ *
+ * @brief Bounded cache of decoded words, keyed on their Morse characters
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Data type includes */
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <stdlib.h> /* calloc, free, malloc, NULL */
+#include <string.h> /* memcmp, memcpy */
+
+/* Local includes */
+#include <morse_cache.h>
+
+
+/* Hash the Morse characters of a word, eight at a time (FNV-1a on
+ * 64-bit words, with the high half folded into the low one) */
+static uint32_t s_hash(const char *key, size_t key_len)
+{
+    uint64_t hash = 14695981039346656037u;
+    uint64_t word;
+    size_t i = 0;
+
+    for (; i + sizeof(word) <= key_len; i += sizeof(word)) {
+        memcpy(&word, &key[i], sizeof(word));
+        hash = (hash ^ word) * 1099511628211u;
+    }
+
+    word = key_len;
+    memcpy(&word, &key[i], key_len - i);
+    hash = (hash ^ word) * 1099511628211u;
+
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+
+/* Initialize a new cache of decoded words */
+morse_cache_td *morse_cache_init(size_t capacity)
+{
+    morse_cache_td *cache;
+    size_t slots = 1;
+
+    /* No power of two of a 'size_t' is above the largest one */
+    if (capacity > SIZE_MAX / 2 + 1) {
+        return NULL;
+    }
+
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    cache = malloc(sizeof(morse_cache_td));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->entries = calloc(slots, sizeof(morse_cache_entry_td));
+    if (cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->mask = slots - 1;
+    cache->hits = 0;
+    cache->misses = 0;
+
+    return cache;
+}
+
+
+/* Destroy the cache */
+void morse_cache_destroy(morse_cache_td *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    free(cache->entries);
+    free(cache);
+}
+
+
+/* Look up a word by its Morse characters */
+const char *morse_cache_lookup(morse_cache_td *cache,
+        const char *key, size_t key_len, uint8_t flags, size_t *length)
+{
+    const morse_cache_entry_td *entry;
+    uint32_t hash = s_hash(key, key_len);
+
+    entry = &cache->entries[hash & cache->mask];
+    if (entry->key_len == key_len && entry->key_len > 0 &&
+            entry->hash == hash && entry->flags == flags &&
+            memcmp(entry->key, key, key_len) == 0) {
+        ++cache->hits;
+        *length = entry->length;
+        return entry->word;
+    }
+
+    ++cache->misses;
+    return NULL;
+}
+
+
+/* Insert a decoded word, replacing the one in the same slot */
+int morse_cache_insert(morse_cache_td *cache, const char *key,
+        size_t key_len, uint8_t flags, const char *word, size_t length)
+{
+    morse_cache_entry_td *entry;
+    uint32_t hash;
+
+    if (key_len == 0 || key_len > MORSE_CACHE_KEY_MAX ||
+            length > MORSE_CACHE_WORD_MAX) {
+        return -1;
+    }
+
+    hash = s_hash(key, key_len);
+    entry = &cache->entries[hash & cache->mask];
+
+    entry->hash = hash;
+    entry->key_len = (uint8_t) key_len;
+    entry->flags = flags;
+    entry->length = (uint8_t) length;
+    memcpy(entry->key, key, key_len);
+    memcpy(entry->word, word, length);
+
+    return 0;
+}
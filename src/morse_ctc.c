@@ -0,0 +1,621 @@
+/**
+ * @file morse_ctc.c
+ *
+ * @brief Chinese telegraph code: conversion between Hanzi and the
+ *        4-digit groups sent over Morse
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <ctype.h>  /* isdigit, isspace */
+#include <stdio.h>  /* FILE, fgets, fwrite */
+#include <stdlib.h> /* calloc, free, malloc, qsort, NULL */
+#include <string.h> /* memcpy, strlen */
+
+/* Local includes */
+#include <morse_ctc.h>
+#include <morse_util.h>
+
+
+/* Characters per bucket of the perfect hash, on average */
+#define MORSE_CTC_BUCKET_LOAD (4)
+
+/* Seeds tried for a bucket before giving up */
+#define MORSE_CTC_SEED_MAX (1u << 24)
+
+/* Maximum length of a line in a code book definition */
+#define MORSE_CTC_LINE_MAX (64)
+
+
+/**
+ * @brief Bucket of the perfect hash, to be placed by decreasing size
+ */
+typedef struct {
+    uint32_t index;     /**< Bucket number */
+    uint32_t first;     /**< First of its characters in the bucket order */
+    uint32_t size;      /**< Number of characters in the bucket */
+} morse_ctc_bucket_td;
+
+
+/* Hash a code point with a seed (MurmurHash3 finalizer) */
+static uint32_t s_hash(uint32_t key, uint32_t seed)
+{
+    uint32_t hash = key ^ (seed * 0x9E3779B9u);
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+
+/* Size in bytes of the tables for a number of characters and buckets */
+static size_t s_tables_size(size_t count, size_t n_buckets)
+{
+    return sizeof(morse_ctc_header_td) +
+        n_buckets * sizeof(int32_t) +
+        count * sizeof(uint32_t) +
+        MORSE_CTC_CODES * sizeof(uint32_t) +
+        count * sizeof(uint16_t);
+}
+
+
+/* Point a code book into its tables */
+static void s_attach(morse_ctc_td *ctc, const void *data)
+{
+    const morse_ctc_header_td *header = data;
+
+    ctc->header = header;
+    ctc->displacement = (const int32_t *) (const void *) (header + 1);
+    ctc->codepoints = (const uint32_t *) (const void *)
+        (ctc->displacement + header->n_buckets);
+    ctc->reverse = ctc->codepoints + header->count;
+    ctc->codes = (const uint16_t *) (const void *)
+        (ctc->reverse + MORSE_CTC_CODES);
+    ctc->size = s_tables_size(header->count, header->n_buckets);
+}
+
+
+/* Order buckets by decreasing size, then by number */
+static int s_compare_buckets(const void *key1, const void *key2)
+{
+    const morse_ctc_bucket_td *bucket1 = key1;
+    const morse_ctc_bucket_td *bucket2 = key2;
+
+    if (bucket1->size != bucket2->size) {
+        return (bucket1->size < bucket2->size) ? 1 : -1;
+    }
+
+    return (bucket1->index > bucket2->index) -
+        (bucket1->index < bucket2->index);
+}
+
+
+/* Find a seed that sends every character of a bucket to a free slot */
+static int s_place_bucket(const uint32_t *keys, uint32_t n_keys,
+        bool *used, uint32_t *slots, uint32_t count)
+{
+    for (uint32_t seed = 1; seed < MORSE_CTC_SEED_MAX; ++seed) {
+        uint32_t i;
+
+        for (i = 0; i < n_keys; ++i) {
+            uint32_t slot = s_hash(keys[i], seed) % count;
+
+            if (used[slot]) {
+                break;
+            }
+            used[slot] = true;
+            slots[i] = slot;
+        }
+
+        if (i == n_keys) {
+            return (int32_t) seed;
+        }
+
+        /* Undo the slots taken by this attempt */
+        while (i-- > 0) {
+            used[slots[i]] = false;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Whether a code point may be in a code book: not ASCII, which is sent
+ * as is, nor a surrogate, nor out of range */
+static bool s_codepoint_valid(uint32_t codepoint)
+{
+    return codepoint >= 0x80 && codepoint <= MORSE_UTF8_CODEPOINT_MAX &&
+        (codepoint < 0xD800 || codepoint > 0xDFFF);
+}
+
+
+/* Build a code book from a list of characters and their groups */
+morse_ctc_td *morse_ctc_build(const uint32_t *codepoints,
+        const uint16_t *codes, size_t count)
+{
+    morse_ctc_td *ctc;
+    morse_ctc_header_td *header;
+    morse_ctc_bucket_td *buckets;
+    uint32_t *order;        /* Characters, grouped by bucket */
+    uint32_t *keys;         /* Code points of a bucket being placed */
+    uint32_t *slots;        /* Slots of a bucket being placed */
+    bool *used;
+    int32_t *displacement;
+    uint32_t *slot_codepoints;
+    uint32_t *reverse;
+    uint16_t *slot_codes;
+    uint32_t n_buckets;
+    uint32_t next_free = 0;
+    int status = 0;
+
+    if (codepoints == NULL || codes == NULL || count == 0 ||
+            count > MORSE_CTC_CODES) {
+        return NULL;
+    }
+
+    n_buckets = (uint32_t) ((count + MORSE_CTC_BUCKET_LOAD - 1) /
+            MORSE_CTC_BUCKET_LOAD);
+
+    ctc = malloc(sizeof(morse_ctc_td));
+    header = calloc(1, s_tables_size(count, n_buckets));
+    buckets = calloc(n_buckets, sizeof(morse_ctc_bucket_td));
+    order = malloc(count * sizeof(uint32_t));
+    keys = malloc(count * sizeof(uint32_t));
+    slots = malloc(count * sizeof(uint32_t));
+    used = calloc(count, sizeof(bool));
+    if (ctc == NULL || header == NULL || buckets == NULL || order == NULL ||
+            keys == NULL || slots == NULL || used == NULL) {
+        status = -1;
+        goto cleanup;
+    }
+
+    header->magic = MORSE_CTC_MAGIC;
+    header->version = MORSE_CTC_VERSION;
+    header->count = (uint32_t) count;
+    header->n_buckets = n_buckets;
+    s_attach(ctc, header);
+    ctc->owned = header;
+
+    displacement = (int32_t *) (void *) (header + 1);
+    slot_codepoints = (uint32_t *) (void *) (displacement + n_buckets);
+    reverse = slot_codepoints + count;
+    slot_codes = (uint16_t *) (void *) (reverse + MORSE_CTC_CODES);
+
+    /* Groups are unique, and their table also finds repeated groups */
+    for (size_t i = 0; i < count; ++i) {
+        if (!s_codepoint_valid(codepoints[i]) ||
+                codes[i] >= MORSE_CTC_CODES || reverse[codes[i]] != 0) {
+            status = -1;
+            goto cleanup;
+        }
+        reverse[codes[i]] = codepoints[i];
+    }
+
+    /* Distribute the characters in buckets (counting sort) */
+    for (uint32_t b = 0; b < n_buckets; ++b) {
+        buckets[b].index = b;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ++buckets[s_hash(codepoints[i], 0) % n_buckets].size;
+    }
+    for (uint32_t b = 0, first = 0; b < n_buckets; ++b) {
+        buckets[b].first = first;
+        first += buckets[b].size;
+        buckets[b].size = 0;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        morse_ctc_bucket_td *bucket =
+            &buckets[s_hash(codepoints[i], 0) % n_buckets];
+
+        order[bucket->first + bucket->size++] = (uint32_t) i;
+    }
+
+    /* Repeated characters share a bucket: find them there */
+    for (uint32_t b = 0; b < n_buckets; ++b) {
+        const uint32_t *members = &order[buckets[b].first];
+
+        for (uint32_t i = 0; i < buckets[b].size; ++i) {
+            for (uint32_t j = i + 1; j < buckets[b].size; ++j) {
+                if (codepoints[members[i]] == codepoints[members[j]]) {
+                    status = -1;
+                    goto cleanup;
+                }
+            }
+        }
+    }
+
+    /* Place the largest buckets first, while most slots are free */
+    qsort(buckets, n_buckets, sizeof(buckets[0]), s_compare_buckets);
+
+    for (uint32_t b = 0; b < n_buckets; ++b) {
+        const morse_ctc_bucket_td *bucket = &buckets[b];
+        const uint32_t *members = &order[bucket->first];
+
+        if (bucket->size == 0) {
+            break;
+        } else if (bucket->size == 1) {
+            /* A single character goes straight to a free slot, stored
+             * as a negative displacement */
+            while (used[next_free]) {
+                ++next_free;
+            }
+            used[next_free] = true;
+            slots[0] = next_free;
+            displacement[bucket->index] = -(int32_t) next_free - 1;
+        } else {
+            int32_t seed;
+
+            for (uint32_t i = 0; i < bucket->size; ++i) {
+                keys[i] = codepoints[members[i]];
+            }
+
+            seed = s_place_bucket(keys, bucket->size, used, slots,
+                    (uint32_t) count);
+            if (seed < 0) {
+                status = -1;
+                goto cleanup;
+            }
+            displacement[bucket->index] = seed;
+        }
+
+        for (uint32_t i = 0; i < bucket->size; ++i) {
+            slot_codepoints[slots[i]] = codepoints[members[i]];
+            slot_codes[slots[i]] = codes[members[i]];
+        }
+    }
+
+cleanup:
+    free(buckets);
+    free(order);
+    free(keys);
+    free(slots);
+    free(used);
+
+    if (status != 0) {
+        free(header);
+        free(ctc);
+        return NULL;
+    }
+
+    return ctc;
+}
+
+
+/* Build a code book from a text list of groups and characters */
+morse_ctc_td *morse_ctc_load(FILE *stream)
+{
+    morse_ctc_td *ctc = NULL;
+    uint32_t *codepoints;
+    uint16_t *codes;
+    char line[MORSE_CTC_LINE_MAX];
+    size_t count = 0;
+
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    codepoints = malloc(MORSE_CTC_CODES * sizeof(uint32_t));
+    codes = malloc(MORSE_CTC_CODES * sizeof(uint16_t));
+    if (codepoints == NULL || codes == NULL) {
+        goto cleanup;
+    }
+
+    while (fgets(line, sizeof(line), stream) != NULL) {
+        size_t len = strlen(line);
+        unsigned code = 0;
+        size_t i;
+        size_t n;
+
+        /* Reject lines that did not fit in the buffer */
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            goto cleanup;
+        }
+
+        if (line[0] == '#' || isspace((unsigned char) line[0])) {
+            continue;
+        }
+
+        for (i = 0; i < MORSE_CTC_DIGITS; ++i) {
+            if (!isdigit((unsigned char) line[i])) {
+                goto cleanup;
+            }
+            code = code * 10 + (unsigned) (line[i] - '0');
+        }
+
+        if (line[i++] != ' ' || count == MORSE_CTC_CODES) {
+            goto cleanup;
+        }
+
+        n = morse_util_utf8_decode((const unsigned char *) &line[i], len - i,
+                &codepoints[count]);
+        if (n == 0) {
+            goto cleanup;
+        }
+
+        /* Only trailing whitespace is allowed after the character */
+        for (i += n; line[i] != '\0'; ++i) {
+            if (!isspace((unsigned char) line[i])) {
+                goto cleanup;
+            }
+        }
+
+        codes[count++] = (uint16_t) code;
+    }
+
+    if (!ferror(stream)) {
+        ctc = morse_ctc_build(codepoints, codes, count);
+    }
+
+cleanup:
+    free(codepoints);
+    free(codes);
+
+    return ctc;
+}
+
+
+/* Use in place the tables of a code book */
+morse_ctc_td *morse_ctc_map(const void *data, size_t size)
+{
+    const morse_ctc_header_td *header = data;
+    morse_ctc_td *ctc;
+
+    if (data == NULL || size < sizeof(morse_ctc_header_td) ||
+            (uintptr_t) data % sizeof(uint32_t) != 0) {
+        return NULL;
+    }
+
+    if (header->magic != MORSE_CTC_MAGIC ||
+            header->version != MORSE_CTC_VERSION ||
+            header->count == 0 || header->count > MORSE_CTC_CODES ||
+            header->n_buckets == 0 || header->n_buckets > header->count ||
+            s_tables_size(header->count, header->n_buckets) > size) {
+        return NULL;
+    }
+
+    ctc = malloc(sizeof(morse_ctc_td));
+    if (ctc == NULL) {
+        return NULL;
+    }
+
+    s_attach(ctc, data);
+    ctc->owned = NULL;
+
+    return ctc;
+}
+
+
+/* Write the tables of a code book */
+int morse_ctc_save(const morse_ctc_td *ctc, FILE *stream)
+{
+    if (ctc == NULL || stream == NULL) {
+        return -1;
+    }
+
+    if (fwrite(ctc->header, 1, ctc->size, stream) != ctc->size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Destroy a code book */
+void morse_ctc_destroy(morse_ctc_td *ctc)
+{
+    if (ctc == NULL) {
+        return;
+    }
+
+    free(ctc->owned);
+    free(ctc);
+}
+
+
+/* Get the group of a character */
+int morse_ctc_code(const morse_ctc_td *ctc, uint32_t codepoint)
+{
+    uint32_t count = ctc->header->count;
+    int32_t seed;
+    uint32_t slot;
+
+    seed = ctc->displacement[s_hash(codepoint, 0) % ctc->header->n_buckets];
+    slot = (seed < 0) ? (uint32_t) -(seed + 1) :
+        s_hash(codepoint, (uint32_t) seed) % count;
+
+    /* Every character lands in some slot: check it's the right one */
+    if (slot >= count || ctc->codepoints[slot] != codepoint ||
+            ctc->codes[slot] >= MORSE_CTC_CODES) {
+        return -1;
+    }
+
+    return ctc->codes[slot];
+}
+
+
+/* Get the character of a group */
+uint32_t morse_ctc_codepoint(const morse_ctc_td *ctc, unsigned code)
+{
+    uint32_t codepoint;
+
+    if (code >= MORSE_CTC_CODES) {
+        return 0;
+    }
+
+    /* Mapped tables are not validated beyond their header */
+    codepoint = ctc->reverse[code];
+    return s_codepoint_valid(codepoint) ? codepoint : 0;
+}
+
+
+/* Replace every character of a UTF-8 text by its group */
+int morse_ctc_to_digits(const morse_ctc_td *ctc,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len)
+{
+    const unsigned char *text = (const unsigned char *) src;
+    size_t len = 0;
+    bool after_group = false;
+    size_t i = 0;
+
+    if (ctc == NULL || dst == NULL || dst_size == 0 || src == NULL) {
+        return -1;
+    }
+
+    while (i < src_len) {
+        uint32_t codepoint;
+        size_t n = morse_util_utf8_decode(&text[i], src_len - i, &codepoint);
+
+        if (n == 0) {
+            return -1;
+        }
+        i += n;
+
+        if (codepoint < 0x80) {
+            char c = (char) codepoint;
+
+            /* A group is followed by a space before anything else */
+            if (after_group && !isspace((unsigned char) c) &&
+                    morse_util_put(dst, dst_size, &len, " ", 1) != 0) {
+                return -1;
+            }
+            if (morse_util_put(dst, dst_size, &len, &c, 1) != 0) {
+                return -1;
+            }
+            after_group = false;
+        } else {
+            char group[MORSE_CTC_DIGITS + 1];
+            int code = morse_ctc_code(ctc, codepoint);
+
+            if (code < 0) {
+                continue;
+            }
+
+            group[0] = ' ';
+            for (int d = MORSE_CTC_DIGITS; d > 0; --d, code /= 10) {
+                group[d] = (char) ('0' + code % 10);
+            }
+
+            /* ... and preceded by one, unless it starts the text or
+             * there's one already */
+            if (len == 0 || isspace((unsigned char) dst[len - 1])) {
+                if (morse_util_put(dst, dst_size, &len, &group[1],
+                            MORSE_CTC_DIGITS) != 0) {
+                    return -1;
+                }
+            } else if (morse_util_put(dst, dst_size, &len, group,
+                        sizeof(group)) != 0) {
+                return -1;
+            }
+            after_group = true;
+        }
+    }
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+
+    return 0;
+}
+
+
+/* Replace every group of a decoded text by its character */
+int morse_ctc_from_digits(const morse_ctc_td *ctc,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len)
+{
+    size_t len = 0;
+    bool after_char = false;
+    size_t i = 0;
+
+    if (ctc == NULL || dst == NULL || dst_size == 0 || src == NULL) {
+        return -1;
+    }
+
+    while (i < src_len) {
+        uint32_t codepoint = 0;
+        size_t start;
+
+        /* Skip the spaces before the next word */
+        start = i;
+        while (i < src_len && src[i] == ' ') {
+            ++i;
+        }
+        if (i == src_len) {
+            break;
+        }
+
+        /* A word made of exactly four digits may be a group */
+        if (i + MORSE_CTC_DIGITS <= src_len &&
+                (i + MORSE_CTC_DIGITS == src_len ||
+                 src[i + MORSE_CTC_DIGITS] == ' ')) {
+            unsigned code = 0;
+            size_t d;
+
+            for (d = 0; d < MORSE_CTC_DIGITS; ++d) {
+                if (!isdigit((unsigned char) src[i + d])) {
+                    break;
+                }
+                code = code * 10 + (unsigned) (src[i + d] - '0');
+            }
+            if (d == MORSE_CTC_DIGITS) {
+                codepoint = morse_ctc_codepoint(ctc, code);
+            }
+        }
+
+        if (codepoint != 0) {
+            char bytes[MORSE_UTF8_LENGTH_MAX];
+            size_t n = morse_util_utf8_encode(codepoint, bytes);
+
+            /* Characters are joined together, but not to other words */
+            if (len > 0 && !after_char &&
+                    morse_util_put(dst, dst_size, &len, " ", 1) != 0) {
+                return -1;
+            }
+            if (morse_util_put(dst, dst_size, &len, bytes, n) != 0) {
+                return -1;
+            }
+            i += MORSE_CTC_DIGITS;
+            after_char = true;
+        } else {
+            size_t end = i;
+
+            while (end < src_len && src[end] != ' ') {
+                ++end;
+            }
+
+            /* Keep the spaces between words, and a single one after a
+             * character */
+            if (len > 0 && (after_char ?
+                        morse_util_put(dst, dst_size, &len, " ", 1) :
+                        morse_util_put(dst, dst_size, &len, &src[start],
+                            i - start)) != 0) {
+                return -1;
+            }
+            if (morse_util_put(dst, dst_size, &len, &src[i], end - i) != 0) {
+                return -1;
+            }
+            i = end;
+            after_char = false;
+        }
+    }
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+
+    return 0;
+}
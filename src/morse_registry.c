@@ -0,0 +1,229 @@
+/**
+ * @file morse_registry.c
+ *
+ * @brief Registry of shared, reference-counted alphabets that can be
+ *        replaced while in use
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Needed by 'clock_gettime' in C99 */
+#define _POSIX_C_SOURCE 199309L
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <sched.h>  /* sched_yield */
+#include <stdio.h>  /* FILE */
+#include <stdlib.h> /* calloc, free, malloc, NULL */
+#include <time.h>   /* clock_gettime, CLOCK_MONOTONIC */
+
+/* Local includes */
+#include <morse_alphabet.h>
+#include <morse_registry.h>
+
+
+/* Checks of a condition before yielding the processor while waiting */
+#define MORSE_REGISTRY_SPINS (64)
+
+
+/* Nanoseconds on the monotonic clock */
+static uint64_t s_now(void)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+
+/* Drop a reference to an instance, freeing it with the last one */
+static void s_instance_put(morse_instance_td *instance)
+{
+    if (instance != NULL &&
+            __atomic_sub_fetch(&instance->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(instance);
+    }
+}
+
+
+/* Publish an instance for an ID and drop the previous one */
+static void s_registry_publish(morse_registry_td *registry, unsigned id,
+        morse_instance_td *instance)
+{
+    morse_instance_td *previous;
+    unsigned long epoch;
+    unsigned spins = 0;
+
+    /* One replacement at a time per ID, so that the epoch doesn't come
+     * back to the one being waited for */
+    while (__atomic_test_and_set(&registry->publishing[id],
+                __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    previous = __atomic_exchange_n(&registry->instances[id], instance,
+            __ATOMIC_SEQ_CST);
+    epoch = __atomic_fetch_add(&registry->epochs[id], 1, __ATOMIC_SEQ_CST);
+
+    /* A client that read the previous instance before the exchange may
+     * not have taken its reference yet: wait until those pinned in the
+     * epoch that has just ended are done, as new ones go to the other */
+    while (__atomic_load_n(&registry->pins[id][epoch & 1],
+                __ATOMIC_SEQ_CST) != 0) {
+        if (++spins >= MORSE_REGISTRY_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+
+    __atomic_clear(&registry->publishing[id], __ATOMIC_RELEASE);
+
+    s_instance_put(previous);
+    __atomic_add_fetch(&registry->reloads, 1, __ATOMIC_RELAXED);
+}
+
+
+/* Record how long a replacement took, from a start on the monotonic
+ * clock */
+static void s_registry_record(morse_registry_td *registry, uint64_t start)
+{
+    uint64_t elapsed = s_now() - start;
+    uint64_t slowest;
+
+    __atomic_store_n(&registry->last_reload, elapsed, __ATOMIC_RELAXED);
+    slowest = __atomic_load_n(&registry->max_reload, __ATOMIC_RELAXED);
+    while (elapsed > slowest &&
+            !__atomic_compare_exchange_n(&registry->max_reload, &slowest,
+                elapsed, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        continue;
+    }
+}
+
+
+/* Initialize a new, empty registry */
+morse_registry_td *morse_registry_init(void)
+{
+    return calloc(1, sizeof(morse_registry_td));
+}
+
+
+/* Destroy the registry, dropping its references */
+void morse_registry_destroy(morse_registry_td *registry)
+{
+    if (registry == NULL) {
+        return;
+    }
+
+    for (unsigned id = 0; id < MORSE_REGISTRY_MAX; ++id) {
+        s_instance_put(registry->instances[id]);
+    }
+
+    free(registry);
+}
+
+
+/* Acquire the instance of an ID */
+const morse_instance_td *morse_registry_acquire(morse_registry_td *registry,
+        unsigned id)
+{
+    morse_instance_td *instance;
+    unsigned long *pins;
+    unsigned long epoch;
+
+    if (registry == NULL || id >= MORSE_REGISTRY_MAX) {
+        return NULL;
+    }
+
+    /* Pin the current epoch, and check that it's still current: from
+     * then on, the publisher that ends it waits for this pin */
+    for (;;) {
+        epoch = __atomic_load_n(&registry->epochs[id], __ATOMIC_SEQ_CST);
+        pins = &registry->pins[id][epoch & 1];
+        __atomic_add_fetch(pins, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&registry->epochs[id], __ATOMIC_SEQ_CST) ==
+                epoch) {
+            break;
+        }
+        __atomic_sub_fetch(pins, 1, __ATOMIC_SEQ_CST);
+    }
+    instance = __atomic_load_n(&registry->instances[id], __ATOMIC_SEQ_CST);
+    if (instance != NULL) {
+        __atomic_add_fetch(&instance->refs, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_sub_fetch(pins, 1, __ATOMIC_SEQ_CST);
+
+    return instance;
+}
+
+
+/* Release an acquired instance */
+void morse_registry_release(const morse_instance_td *instance)
+{
+    s_instance_put((morse_instance_td *) instance);
+}
+
+
+/* Replace the instance of an ID with a copy of an alphabet */
+int morse_registry_swap(morse_registry_td *registry, unsigned id,
+        const morse_alphabet_td *alphabet, uint8_t flags)
+{
+    morse_instance_td *instance = NULL;
+    uint64_t start = s_now();
+
+    if (registry == NULL || id >= MORSE_REGISTRY_MAX) {
+        return -1;
+    }
+
+    if (alphabet != NULL) {
+        instance = malloc(sizeof(morse_instance_td));
+        if (instance == NULL) {
+            return -1;
+        }
+
+        instance->alphabet = *alphabet;
+        instance->flags = flags;
+        instance->refs = 1;
+    }
+
+    s_registry_publish(registry, id, instance);
+    s_registry_record(registry, start);
+
+    return 0;
+}
+
+
+/* Read an alphabet and replace the instance of an ID with it */
+int morse_registry_load(morse_registry_td *registry, unsigned id,
+        FILE *stream, uint8_t flags)
+{
+    morse_instance_td *instance;
+    uint64_t start = s_now();
+
+    if (registry == NULL || id >= MORSE_REGISTRY_MAX || stream == NULL) {
+        return -1;
+    }
+
+    instance = malloc(sizeof(morse_instance_td));
+    if (instance == NULL) {
+        return -1;
+    }
+
+    if (morse_alphabet_load(&instance->alphabet, stream) != 0) {
+        free(instance);
+        return -1;
+    }
+    instance->flags = flags;
+    instance->refs = 1;
+
+    s_registry_publish(registry, id, instance);
+    s_registry_record(registry, start);
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file morse_util.c
+ *
+ * @brief Helpers shared by the encoders and decoders: bounded output,
+ *        UTF-8 and code words being received
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <string.h> /* memcpy */
+
+/* Local includes */
+#include <morse_alphabet.h>
+#include <morse_util.h>
+
+
+/* Append bytes to a bounded output, keeping it null-terminated */
+int morse_util_put(char *dst, size_t dst_size, size_t *len,
+        const char *src, size_t n)
+{
+    /* Always keep room for the terminating null character */
+    if (*len + n >= dst_size) {
+        return -1;
+    }
+
+    memcpy(&dst[*len], src, n);
+    *len += n;
+    dst[*len] = '\0';
+
+    return 0;
+}
+
+
+/* Decode a UTF-8 sequence, returning its length, or 0 if malformed */
+size_t morse_util_utf8_decode(const unsigned char *src, size_t len,
+        uint32_t *codepoint)
+{
+    uint32_t value;
+    size_t n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (src[0] < 0x80) {
+        *codepoint = src[0];
+        return 1;
+    } else if ((src[0] & 0xE0) == 0xC0) {
+        value = src[0] & 0x1Fu;
+        n = 2;
+    } else if ((src[0] & 0xF0) == 0xE0) {
+        value = src[0] & 0x0Fu;
+        n = 3;
+    } else if ((src[0] & 0xF8) == 0xF0) {
+        value = src[0] & 0x07u;
+        n = 4;
+    } else {
+        return 0;
+    }
+
+    if (len < n) {
+        return 0;
+    }
+
+    for (size_t i = 1; i < n; ++i) {
+        if ((src[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        value = (value << 6) | (src[i] & 0x3Fu);
+    }
+
+    /* Reject overlong forms, surrogates and values out of range */
+    if ((n == 2 && value < 0x80) || (n == 3 && value < 0x800) ||
+            (n == 4 && value < 0x10000) ||
+            (value >= 0xD800 && value <= 0xDFFF) ||
+            value > MORSE_UTF8_CODEPOINT_MAX) {
+        return 0;
+    }
+
+    *codepoint = value;
+    return n;
+}
+
+
+/* Encode a code point in UTF-8, returning its length */
+size_t morse_util_utf8_encode(uint32_t codepoint, char *dst)
+{
+    if (codepoint < 0x80) {
+        dst[0] = (char) codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        dst[0] = (char) (0xC0 | (codepoint >> 6));
+        dst[1] = (char) (0x80 | (codepoint & 0x3F));
+        return 2;
+    } else if (codepoint < 0x10000) {
+        dst[0] = (char) (0xE0 | (codepoint >> 12));
+        dst[1] = (char) (0x80 | ((codepoint >> 6) & 0x3F));
+        dst[2] = (char) (0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+
+    dst[0] = (char) (0xF0 | (codepoint >> 18));
+    dst[1] = (char) (0x80 | ((codepoint >> 12) & 0x3F));
+    dst[2] = (char) (0x80 | ((codepoint >> 6) & 0x3F));
+    dst[3] = (char) (0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+
+/* Append an element to the heap index of a code word being received */
+unsigned morse_util_code_push(unsigned code, bool is_dah)
+{
+    /* Once too long, the code word remains invalid */
+    if (code == MORSE_ALPHABET_NO_CODE || code >= MORSE_ALPHABET_CODES / 2) {
+        return MORSE_ALPHABET_NO_CODE;
+    }
+
+    return (code << 1) | is_dah;
+}
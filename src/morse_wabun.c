@@ -0,0 +1,492 @@
+/**
+ * @file morse_wabun.c
+ *
+ * @brief Wabun code: Japanese kana and Latin characters in the same
+ *        stream, switching alphabets with prosigns
+ *
+ * @author J. A. Corbal (<jacorbal@gmail.com>)
+ */
+
+/* Data type includes */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* System includes */
+#include <ctype.h>  /* toupper */
+#include <stdlib.h> /* NULL */
+#include <string.h> /* memset, strlen */
+
+/* Local includes */
+#include <morse.h>
+#include <morse_alphabet.h>
+#include <morse_util.h>
+#include <morse_wabun.h>
+
+
+/* Heap indices of the prosigns that switch modes */
+#define MORSE_WABUN_CODE_DO (0x67)  /* -..--- : to kana mode */
+#define MORSE_WABUN_CODE_SN (0x22)  /* ...-.  : to Latin mode */
+
+/* Symbols from this value on are a shift to the mode in the low byte */
+#define MORSE_WABUN_SHIFT (0xFF00u)
+
+/* Gaps due before the next character */
+#define MORSE_WABUN_GAP_NONE (0)    /* Nothing sent yet */
+#define MORSE_WABUN_GAP_CHAR (1)
+#define MORSE_WABUN_GAP_WORD (2)
+
+/* Voiced and semi-voiced sound marks */
+#define MORSE_WABUN_DAKUTEN (0x309B)
+#define MORSE_WABUN_HANDAKUTEN (0x309C)
+
+/* Distance from a hiragana to its katakana */
+#define MORSE_WABUN_HIRAGANA_FIRST (0x3041)
+#define MORSE_WABUN_HIRAGANA_LAST (0x3096)
+#define MORSE_WABUN_HIRAGANA_SHIFT (0x60)
+
+
+/**
+ * @brief Character of the kana mode and its code word
+ */
+typedef struct {
+    uint16_t codepoint;     /**< Unicode code point */
+    const char *elements;   /**< Dits and dahs */
+} morse_wabun_kana_td;
+
+/**
+ * @brief Character of the kana mode sent as another one plus a mark
+ */
+typedef struct {
+    uint16_t codepoint;     /**< Unicode code point */
+    uint16_t base;          /**< Character sent first */
+    uint16_t mark;          /**< Mark sent after it, or 0 if none */
+} morse_wabun_composed_td;
+
+
+/* Code words of the kana mode */
+static const morse_wabun_kana_td s_wabun_kana[] = {
+    {0x30A4, ".-"},     /* イ */    {0x30ED, ".-.-"},   /* ロ */
+    {0x30CF, "-..."},   /* ハ */    {0x30CB, "-.-."},   /* ニ */
+    {0x30DB, "-.."},    /* ホ */    {0x30D8, "."},      /* ヘ */
+    {0x30C8, "..-.."},  /* ト */    {0x30C1, "..-."},   /* チ */
+    {0x30EA, "--."},    /* リ */    {0x30CC, "...."},   /* ヌ */
+    {0x30EB, "-.--."},  /* ル */    {0x30F2, ".---"},   /* ヲ */
+    {0x30EF, "-.-"},    /* ワ */    {0x30AB, ".-.."},   /* カ */
+    {0x30E8, "--"},     /* ヨ */    {0x30BF, "-."},     /* タ */
+    {0x30EC, "---"},    /* レ */    {0x30BD, "---."},   /* ソ */
+    {0x30C4, ".--."},   /* ツ */    {0x30CD, "--.-"},   /* ネ */
+    {0x30CA, ".-."},    /* ナ */    {0x30E9, "..."},    /* ラ */
+    {0x30E0, "-"},      /* ム */    {0x30A6, "..-"},    /* ウ */
+    {0x30F0, ".-..-"},  /* ヰ */    {0x30CE, "..--"},   /* ノ */
+    {0x30AA, ".-..."},  /* オ */    {0x30AF, "...-"},   /* ク */
+    {0x30E4, ".--"},    /* ヤ */    {0x30DE, "-..-"},   /* マ */
+    {0x30B1, "-.--"},   /* ケ */    {0x30D5, "--.."},   /* フ */
+    {0x30B3, "----"},   /* コ */    {0x30A8, "-.---"},  /* エ */
+    {0x30C6, ".-.--"},  /* テ */    {0x30A2, "--.--"},  /* ア */
+    {0x30B5, "-.-.-"},  /* サ */    {0x30AD, "-.-.."},  /* キ */
+    {0x30E6, "-..--"},  /* ユ */    {0x30E1, "-...-"},  /* メ */
+    {0x30DF, "..-.-"},  /* ミ */    {0x30B7, "--.-."},  /* シ */
+    {0x30F1, ".--.."},  /* ヱ */    {0x30D2, "--..-"},  /* ヒ */
+    {0x30E2, "-..-."},  /* モ */    {0x30BB, ".---."},  /* セ */
+    {0x30B9, "---.-"},  /* ス */    {0x30F3, ".-.-."},  /* ン */
+    {0x309B, ".."},     /* ゛ */    {0x309C, "..--."},  /* ゜ */
+    {0x30FC, ".--.-"},  /* ー */    {0x3001, ".-.-.-"}, /* 、 */
+};
+
+/* Voiced, semi-voiced and small kana */
+static const morse_wabun_composed_td s_wabun_composed[] = {
+    {0x30AC, 0x30AB, MORSE_WABUN_DAKUTEN},      /* ガ */
+    {0x30AE, 0x30AD, MORSE_WABUN_DAKUTEN},      /* ギ */
+    {0x30B0, 0x30AF, MORSE_WABUN_DAKUTEN},      /* グ */
+    {0x30B2, 0x30B1, MORSE_WABUN_DAKUTEN},      /* ゲ */
+    {0x30B4, 0x30B3, MORSE_WABUN_DAKUTEN},      /* ゴ */
+    {0x30B6, 0x30B5, MORSE_WABUN_DAKUTEN},      /* ザ */
+    {0x30B8, 0x30B7, MORSE_WABUN_DAKUTEN},      /* ジ */
+    {0x30BA, 0x30B9, MORSE_WABUN_DAKUTEN},      /* ズ */
+    {0x30BC, 0x30BB, MORSE_WABUN_DAKUTEN},      /* ゼ */
+    {0x30BE, 0x30BD, MORSE_WABUN_DAKUTEN},      /* ゾ */
+    {0x30C0, 0x30BF, MORSE_WABUN_DAKUTEN},      /* ダ */
+    {0x30C2, 0x30C1, MORSE_WABUN_DAKUTEN},      /* ヂ */
+    {0x30C5, 0x30C4, MORSE_WABUN_DAKUTEN},      /* ヅ */
+    {0x30C7, 0x30C6, MORSE_WABUN_DAKUTEN},      /* デ */
+    {0x30C9, 0x30C8, MORSE_WABUN_DAKUTEN},      /* ド */
+    {0x30D0, 0x30CF, MORSE_WABUN_DAKUTEN},      /* バ */
+    {0x30D3, 0x30D2, MORSE_WABUN_DAKUTEN},      /* ビ */
+    {0x30D6, 0x30D5, MORSE_WABUN_DAKUTEN},      /* ブ */
+    {0x30D9, 0x30D8, MORSE_WABUN_DAKUTEN},      /* ベ */
+    {0x30DC, 0x30DB, MORSE_WABUN_DAKUTEN},      /* ボ */
+    {0x30F4, 0x30A6, MORSE_WABUN_DAKUTEN},      /* ヴ */
+    {0x30D1, 0x30CF, MORSE_WABUN_HANDAKUTEN},   /* パ */
+    {0x30D4, 0x30D2, MORSE_WABUN_HANDAKUTEN},   /* ピ */
+    {0x30D7, 0x30D5, MORSE_WABUN_HANDAKUTEN},   /* プ */
+    {0x30DA, 0x30D8, MORSE_WABUN_HANDAKUTEN},   /* ペ */
+    {0x30DD, 0x30DB, MORSE_WABUN_HANDAKUTEN},   /* ポ */
+    {0x30A1, 0x30A2, 0},    /* ァ */    {0x30A3, 0x30A4, 0},    /* ィ */
+    {0x30A5, 0x30A6, 0},    /* ゥ */    {0x30A7, 0x30A8, 0},    /* ェ */
+    {0x30A9, 0x30AA, 0},    /* ォ */    {0x30C3, 0x30C4, 0},    /* ッ */
+    {0x30E3, 0x30E4, 0},    /* ャ */    {0x30E5, 0x30E6, 0},    /* ュ */
+    {0x30E7, 0x30E8, 0},    /* ョ */    {0x30EE, 0x30EF, 0},    /* ヮ */
+    {0x30F5, 0x30AB, 0},    /* ヵ */    {0x30F6, 0x30B1, 0},    /* ヶ */
+};
+
+
+/* Heap index of the code word written as dits and dahs */
+static unsigned s_wabun_parse(const char *elements)
+{
+    unsigned code = 1;
+
+    for (size_t i = 0; elements[i] != '\0'; ++i) {
+        code = (code << 1) | (elements[i] == MORSE_DAH[0]);
+    }
+
+    return code;
+}
+
+
+/* Send a code word, after the gap due before it */
+static int s_wabun_encode_code(morse_wabun_state_td *state, unsigned code,
+        bool use_separators, char *dst, size_t dst_size, size_t *len)
+{
+    if (use_separators) {
+        if (state->gap == MORSE_WABUN_GAP_WORD &&
+                morse_util_put(dst, dst_size, len, MORSE_WORD_SEPARATOR,
+                    strlen(MORSE_WORD_SEPARATOR)) != 0) {
+            return -1;
+        } else if (state->gap == MORSE_WABUN_GAP_CHAR &&
+                morse_util_put(dst, dst_size, len, MORSE_CHAR_SEPARATOR,
+                    strlen(MORSE_CHAR_SEPARATOR)) != 0) {
+            return -1;
+        }
+    }
+
+    /* Elements are the bits below the leading 1, first one highest */
+    for (unsigned i = morse_alphabet_length(code); i > 0; --i) {
+        if (morse_util_put(dst, dst_size, len, ((code >> (i - 1)) & 1) ?
+                    MORSE_DAH : MORSE_DIT, 1) != 0) {
+            return -1;
+        }
+        if (use_separators &&
+                morse_util_put(dst, dst_size, len, MORSE_SEP, 1) != 0) {
+            return -1;
+        }
+    }
+
+    state->gap = MORSE_WABUN_GAP_CHAR;
+
+    return 0;
+}
+
+
+/* Decode the code word received, or follow it to another mode; the
+ * state is left untouched if the output is full */
+static int s_wabun_decode_code(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state, char *dst, size_t dst_size,
+        size_t *len)
+{
+    char bytes[MORSE_UTF8_LENGTH_MAX];
+    unsigned symbol = wabun->symbol[state->mode][state->code];
+    size_t start = *len;
+    size_t n;
+
+    if (symbol >= MORSE_WABUN_SHIFT) {
+        state->mode = (uint8_t) (symbol - MORSE_WABUN_SHIFT);
+        state->code = 1;
+        return 0;
+    } else if (symbol == 0) {
+        state->code = 1;
+        return 0;
+    }
+
+    n = morse_util_utf8_encode(symbol, bytes);
+    if ((state->gap == MORSE_WABUN_GAP_WORD &&
+                morse_util_put(dst, dst_size, len, " ", 1) != 0) ||
+            morse_util_put(dst, dst_size, len, bytes, n) != 0) {
+        *len = start;
+        return -1;
+    }
+
+    state->code = 1;
+    state->gap = MORSE_WABUN_GAP_CHAR;
+
+    return 0;
+}
+
+
+/* Build the tables of the Wabun code */
+int morse_wabun_init(morse_wabun_td *wabun, const morse_alphabet_td *latin)
+{
+    uint16_t *kana_code;
+
+    if (wabun == NULL || latin == NULL) {
+        return -1;
+    }
+
+    memset(wabun, 0, sizeof(morse_wabun_td));
+
+    /* Latin mode: the alphabet, lowercase included */
+    for (int c = 0; c < MORSE_ALPHABET_SYMBOLS; ++c) {
+        wabun->code[MORSE_WABUN_LATIN][c] = latin->code[toupper(c)];
+    }
+    for (int code = 0; code < MORSE_ALPHABET_CODES; ++code) {
+        wabun->symbol[MORSE_WABUN_LATIN][code] =
+            (unsigned char) latin->symbol[code];
+    }
+
+    /* Kana mode */
+    kana_code = wabun->code[MORSE_WABUN_KANA];
+    for (size_t i = 0; i < sizeof(s_wabun_kana) / sizeof(s_wabun_kana[0]);
+            ++i) {
+        unsigned code = s_wabun_parse(s_wabun_kana[i].elements);
+
+        kana_code[s_wabun_kana[i].codepoint - MORSE_WABUN_KANA_FIRST] =
+            (uint16_t) code;
+        wabun->symbol[MORSE_WABUN_KANA][code] = s_wabun_kana[i].codepoint;
+    }
+    for (size_t i = 0;
+            i < sizeof(s_wabun_composed) / sizeof(s_wabun_composed[0]);
+            ++i) {
+        const morse_wabun_composed_td *composed = &s_wabun_composed[i];
+        uint16_t mark = (composed->mark == 0) ? 0 :
+            kana_code[composed->mark - MORSE_WABUN_KANA_FIRST];
+
+        kana_code[composed->codepoint - MORSE_WABUN_KANA_FIRST] = (uint16_t)
+            (kana_code[composed->base - MORSE_WABUN_KANA_FIRST] |
+             (mark << 8));
+    }
+    for (unsigned cp = MORSE_WABUN_HIRAGANA_FIRST;
+            cp <= MORSE_WABUN_HIRAGANA_LAST; ++cp) {
+        kana_code[cp - MORSE_WABUN_KANA_FIRST] = kana_code[cp +
+            MORSE_WABUN_HIRAGANA_SHIFT - MORSE_WABUN_KANA_FIRST];
+    }
+
+    /* The prosigns must not hide characters */
+    if (wabun->symbol[MORSE_WABUN_LATIN][MORSE_WABUN_CODE_DO] != 0 ||
+            wabun->symbol[MORSE_WABUN_KANA][MORSE_WABUN_CODE_SN] != 0) {
+        return -1;
+    }
+    wabun->symbol[MORSE_WABUN_LATIN][MORSE_WABUN_CODE_DO] =
+        MORSE_WABUN_SHIFT | MORSE_WABUN_KANA;
+    wabun->symbol[MORSE_WABUN_KANA][MORSE_WABUN_CODE_SN] =
+        MORSE_WABUN_SHIFT | MORSE_WABUN_LATIN;
+
+    return 0;
+}
+
+
+/* Start the encoding or the decoding of a stream in Latin mode */
+void morse_wabun_state_init(morse_wabun_state_td *state)
+{
+    state->mode = MORSE_WABUN_LATIN;
+    state->code = 1;
+    state->spaces = 0;
+    state->gap = MORSE_WABUN_GAP_NONE;
+}
+
+
+/* Pack the state of a stream into bytes */
+void morse_wabun_state_pack(const morse_wabun_state_td *state,
+        uint8_t bytes[MORSE_WABUN_STATE_SIZE])
+{
+    bytes[0] = state->mode;
+    bytes[1] = state->code;
+    bytes[2] = state->spaces;
+    bytes[3] = state->gap;
+}
+
+
+/* Unpack the state of a stream from bytes */
+int morse_wabun_state_unpack(morse_wabun_state_td *state,
+        const uint8_t bytes[MORSE_WABUN_STATE_SIZE])
+{
+    if (bytes[0] >= MORSE_WABUN_MODES || bytes[3] > MORSE_WABUN_GAP_WORD) {
+        return -1;
+    }
+
+    state->mode = bytes[0];
+    state->code = bytes[1];
+    state->spaces = bytes[2];
+    state->gap = bytes[3];
+
+    return 0;
+}
+
+
+/* Encode a chunk of UTF-8 text, switching modes as needed */
+int morse_wabun_encode(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, size_t *src_used, uint8_t flags)
+{
+    static const unsigned shift[MORSE_WABUN_MODES] = {
+        MORSE_WABUN_CODE_SN, MORSE_WABUN_CODE_DO
+    };
+    const unsigned char *text = (const unsigned char *) src;
+    bool use_separators = (flags & MORSE_USE_SEPARATORS) > 0;
+    int status = 0;
+    size_t len = 0;
+    size_t i = 0;
+
+    if (wabun == NULL || state == NULL || dst == NULL || dst_size == 0 ||
+            src == NULL) {
+        return -1;
+    }
+
+    while (i < src_len) {
+        morse_wabun_state_td saved = *state;
+        size_t start = i;
+        size_t saved_len = len;
+        uint32_t cp;
+        size_t n = morse_util_utf8_decode(&text[i], src_len - i, &cp);
+        unsigned mode;
+        unsigned codes;
+
+        if (n == 0) {
+            /* Stop before it, as when the output is full */
+            status = -1;
+            break;
+        }
+        i += n;
+
+        if (cp == ' ') {
+            if (state->gap != MORSE_WABUN_GAP_NONE) {
+                state->gap = MORSE_WABUN_GAP_WORD;
+            }
+            continue;
+        }
+
+        if (cp < MORSE_ALPHABET_SYMBOLS) {
+            mode = MORSE_WABUN_LATIN;
+        } else if (cp >= MORSE_WABUN_KANA_FIRST &&
+                cp < MORSE_WABUN_KANA_FIRST + MORSE_WABUN_SYMBOLS) {
+            mode = MORSE_WABUN_KANA;
+            cp -= MORSE_WABUN_KANA_FIRST;
+        } else {
+            continue;
+        }
+
+        codes = wabun->code[mode][cp];
+        if (codes == MORSE_ALPHABET_NO_CODE) {
+            continue;
+        }
+
+        /* A character is sent whole, with its shift, or not at all */
+        if ((state->mode != mode &&
+                    s_wabun_encode_code(state, shift[mode], use_separators,
+                        dst, dst_size, &len) != 0) ||
+                s_wabun_encode_code(state, codes & 0xFF, use_separators,
+                    dst, dst_size, &len) != 0 ||
+                ((codes >> 8) != 0 && s_wabun_encode_code(state, codes >> 8,
+                    use_separators, dst, dst_size, &len) != 0)) {
+            *state = saved;
+            len = saved_len;
+            i = start;
+            status = 1;
+            break;
+        }
+        state->mode = (uint8_t) mode;
+    }
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+    if (src_used != NULL) {
+        *src_used = i;
+    }
+
+    return status;
+}
+
+
+/* Decode a chunk of Morse characters, following the shifts of mode */
+int morse_wabun_decode(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len,
+        const char *src, size_t src_len, size_t *src_used, uint8_t flags)
+{
+    size_t char_gap = 1;
+    size_t word_gap = 2;
+    int status = 0;
+    size_t len = 0;
+    size_t i;
+
+    if (wabun == NULL || state == NULL || dst == NULL || dst_size == 0 ||
+            src == NULL) {
+        return -1;
+    }
+
+    /* With separators, every element is followed by one already */
+    if (flags & MORSE_USE_SEPARATORS) {
+        char_gap = strlen(MORSE_SEP) + strlen(MORSE_CHAR_SEPARATOR);
+        word_gap = strlen(MORSE_SEP) + strlen(MORSE_WORD_SEPARATOR);
+    }
+
+    for (i = 0; i < src_len; ++i) {
+        if (src[i] == ' ') {
+            if (state->spaces < UINT8_MAX) {
+                ++state->spaces;
+            }
+            continue;
+        } else if (src[i] != MORSE_DIT[0] && src[i] != MORSE_DAH[0]) {
+            continue;
+        }
+
+        /* The gap before this element is complete now; if its
+         * character doesn't fit, the element is left for the next call */
+        if (state->spaces >= char_gap && state->code != 1 &&
+                s_wabun_decode_code(wabun, state, dst, dst_size,
+                    &len) != 0) {
+            status = 1;
+            break;
+        }
+        if (state->spaces >= word_gap &&
+                state->gap != MORSE_WABUN_GAP_NONE) {
+            state->gap = MORSE_WABUN_GAP_WORD;
+        }
+        state->spaces = 0;
+
+        state->code = (uint8_t) morse_util_code_push(state->code,
+                src[i] == MORSE_DAH[0]);
+    }
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+    if (src_used != NULL) {
+        *src_used = i;
+    }
+
+    return status;
+}
+
+
+/* Decode the character pending at the end of a stream */
+int morse_wabun_decode_flush(const morse_wabun_td *wabun,
+        morse_wabun_state_td *state,
+        char *dst, size_t dst_size, size_t *dst_len)
+{
+    size_t len = 0;
+
+    if (wabun == NULL || state == NULL || dst == NULL || dst_size == 0) {
+        return -1;
+    }
+
+    if (state->code != 1 &&
+            s_wabun_decode_code(wabun, state, dst, dst_size, &len) != 0) {
+        dst[0] = '\0';
+        if (dst_len != NULL) {
+            *dst_len = 0;
+        }
+        return 1;
+    }
+    state->spaces = 0;
+
+    dst[len] = '\0';
+    if (dst_len != NULL) {
+        *dst_len = len;
+    }
+
+    return 0;
+}